@@ -0,0 +1,220 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench.h"
+#include "config.h"
+#include "shader.h"
+#include "render.h"
+#include "pacer.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <GL/glew.h>
+#include <GL/glx.h>
+
+#define BENCH_WARMUP_FRAMES 30
+#define BENCH_DT (1.0f / 60.0f)
+#define BENCH_TAU 6.28318530718f
+
+typedef struct {
+    const char* name;
+    float scale_from;
+    float scale_to;
+    bool flashlight;
+    float radius;
+    bool blur_outside;
+    bool blur_background;
+    float blur_radius;
+} BenchScenario;
+
+static const BenchScenario scenarios[] = {
+    {"plain-1x",                1.0f,  1.0f,  false, 0.0f,   false, false, 0.0f},
+    {"zoom-in-8x",              1.0f,  8.0f,  false, 0.0f,   false, false, 0.0f},
+    {"zoom-out-0.25x",          1.0f,  0.25f, false, 0.0f,   false, false, 0.0f},
+    {"background-blur-0.5x",    0.5f,  0.5f,  false, 0.0f,   false, true,  10.0f},
+    {"flashlight-r100",         1.0f,  2.0f,  true,  100.0f, false, false, 0.0f},
+    {"flashlight-r600",         1.0f,  2.0f,  true,  600.0f, false, false, 0.0f},
+    {"flashlight-blur-r10",     1.0f,  2.0f,  true,  200.0f, true,  false, 10.0f},
+    {"flashlight-blur-r30",     1.0f,  2.0f,  true,  200.0f, true,  false, 30.0f},
+    {"flashlight-blur-all-4x",  4.0f,  4.0f,  true,  200.0f, true,  true,  10.0f},
+};
+
+// Deterministic stand-in for a desktop: flat panels, gradients and
+// high-frequency "text" rows so both the blur and the lens have detail.
+static Screenshot create_synthetic_screenshot(Display* display, int width, int height) {
+    char* data = malloc((size_t)width * height * 4);
+    uint32_t* pixels = (uint32_t*)data;
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint32_t r = (uint32_t)(x * 255 / width);
+            uint32_t g = (uint32_t)(y * 255 / height);
+            uint32_t b = ((x / 64) ^ (y / 64)) & 1 ? 0xD0 : 0x30;
+            // Glyph-like noise on every other 16 pixel row band
+            if ((y / 16) % 2 == 0 && ((x * 7919u + y * 104729u) >> 3) % 5 == 0) {
+                r = g = b = 0x10;
+            }
+            pixels[(size_t)y * width + x] = 0xFF000000u | (r << 16) | (g << 8) | b;
+        }
+    }
+
+    Screenshot screenshot = {0};
+    screenshot.image = XCreateImage(display, DefaultVisual(display, DefaultScreen(display)), 24,
+                                    ZPixmap, 0, data, width, height, 32, 0);
+    screenshot.dirty[0] = (XRectangle){0, 0, (unsigned short)width, (unsigned short)height};
+    screenshot.dirty_count = 1;
+    return screenshot;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, int count, double p) {
+    int index = (int)(p * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+static void run_scenario(const BenchScenario* scenario, ShaderLibrary* shaders, const Screenshot* screenshot,
+                         GLuint framebuffer, int width, int height, int frames, bool last) {
+    Config saved = config;
+    config.blur_outside_flashlight = scenario->blur_outside;
+    config.blur_background = scenario->blur_background;
+    config.outside_flashlight_blur_radius = scenario->blur_radius;
+    config.background_blur_radius = scenario->blur_radius;
+
+    Renderer renderer;
+    create_renderer(&renderer, shaders, screenshot);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+
+    Camera camera = {.scale = 1.0f, .target_scale = 1.0f};
+    Flashlight flashlight = {
+        .is_enabled = scenario->flashlight,
+        .shadow = scenario->flashlight ? 0.8f : 0.0f,
+        .radius = scenario->radius,
+        .target_radius = scenario->radius,
+        .position = {width * 0.5f, height * 0.5f},
+        .mass = config.bubble_mass,
+        .spring_k = config.bubble_spring_k,
+        .damping = config.bubble_damping,
+    };
+    Vec2f window_size = {(float)width, (float)height};
+
+    double* samples = malloc(frames * sizeof(double));
+    for (int frame = -BENCH_WARMUP_FRAMES; frame < frames; frame++) {
+        // Zoom oscillates between the two scales while the camera circles
+        // and the flashlight follows a Lissajous path across the window
+        float t = (float)(frame + BENCH_WARMUP_FRAMES) / (float)(frames + BENCH_WARMUP_FRAMES);
+        float zoom = 0.5f - 0.5f * cosf(BENCH_TAU * t);
+        camera.scale = scenario->scale_from + (scenario->scale_to - scenario->scale_from) * zoom;
+        camera.position = (Vec2f){200.0f * cosf(BENCH_TAU * t),
+                                  200.0f * sinf(BENCH_TAU * t)};
+        Vec2f cursor = {width * (0.5f + 0.4f * sinf(3.0f * BENCH_TAU * t)),
+                        height * (0.5f + 0.4f * sinf(2.0f * BENCH_TAU * t))};
+        update_flashlight(&flashlight, BENCH_DT, cursor);
+
+        double start = monotonic_seconds();
+        draw_scene(&renderer, screenshot, &camera, &flashlight, window_size);
+        glFinish();
+        double elapsed = monotonic_seconds() - start;
+
+        if (frame >= 0) {
+            samples[frame] = elapsed * 1000.0;
+        }
+    }
+
+    double total = 0.0;
+    for (int i = 0; i < frames; i++) total += samples[i];
+    qsort(samples, frames, sizeof(double), compare_doubles);
+
+    printf("    {\"name\": \"%s\", \"frames\": %d, \"mean_ms\": %.4f, \"p50_ms\": %.4f, "
+           "\"p90_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f}%s\n",
+           scenario->name, frames, total / frames,
+           percentile(samples, frames, 0.50), percentile(samples, frames, 0.90),
+           percentile(samples, frames, 0.99), samples[frames - 1], last ? "" : ",");
+
+    free(samples);
+    destroy_renderer(&renderer);
+    config = saved;
+}
+
+// Render every scenario into an offscreen framebuffer and print frame time
+// percentiles as JSON on stdout. Works on any X server, including Xvfb with llvmpipe.
+int run_bench(Display* display, const BenchOptions* options) {
+    int screen = DefaultScreen(display);
+    int width = options->width > 0 ? options->width : DisplayWidth(display, screen);
+    int height = options->height > 0 ? options->height : DisplayHeight(display, screen);
+    int frames = options->frames > 0 ? options->frames : 300;
+
+    int fb_attrs[] = {
+        GLX_DRAWABLE_TYPE, GLX_PBUFFER_BIT,
+        GLX_RENDER_TYPE, GLX_RGBA_BIT,
+        GLX_RED_SIZE, 8, GLX_GREEN_SIZE, 8, GLX_BLUE_SIZE, 8,
+        None
+    };
+    int count = 0;
+    GLXFBConfig* fb_configs = glXChooseFBConfig(display, screen, fb_attrs, &count);
+    if (!fb_configs || count == 0) {
+        fprintf(stderr, "No pbuffer capable framebuffer config found\n");
+        return 1;
+    }
+
+    // The pbuffer only anchors the context, all rendering goes to an FBO
+    int pbuffer_attrs[] = {GLX_PBUFFER_WIDTH, 16, GLX_PBUFFER_HEIGHT, 16, None};
+    GLXPbuffer pbuffer = glXCreatePbuffer(display, fb_configs[0], pbuffer_attrs);
+    GLXContext context = glXCreateNewContext(display, fb_configs[0], GLX_RGBA_TYPE, NULL, True);
+    XFree(fb_configs);
+    glXMakeContextCurrent(display, pbuffer, pbuffer, context);
+
+    glewExperimental = GL_TRUE;
+    GLenum glew_err = glewInit();
+    if (glew_err != GLEW_OK) {
+        fprintf(stderr, "GLEW initialization failed: %s\n", glewGetErrorString(glew_err));
+        return 1;
+    }
+
+    ShaderLibrary shaders;
+    create_shader_library(&shaders, config.vertex_shader_path, config.fragment_shader_path);
+
+    Screenshot screenshot = options->capture
+        ? create_screenshot(display, DefaultRootWindow(display))
+        : create_synthetic_screenshot(display, width, height);
+
+    GLuint target, framebuffer;
+    glGenTextures(1, &target);
+    glBindTexture(GL_TEXTURE_2D, target);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+
+    printf("{\n");
+    printf("  \"renderer\": \"%s\",\n", glGetString(GL_RENDERER));
+    printf("  \"version\": \"%s\",\n", glGetString(GL_VERSION));
+    printf("  \"width\": %d,\n  \"height\": %d,\n", width, height);
+    printf("  \"screenshot\": \"%s\",\n", options->capture ? "capture" : "synthetic");
+    printf("  \"scenarios\": [\n");
+
+    int scenario_count = sizeof(scenarios) / sizeof(scenarios[0]);
+    for (int i = 0; i < scenario_count; i++) {
+        run_scenario(&scenarios[i], &shaders, &screenshot, framebuffer, width, height, frames,
+                     i == scenario_count - 1);
+        fflush(stdout);
+    }
+
+    printf("  ]\n}\n");
+
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &target);
+    destroy_shader_library(&shaders);
+    destroy_screenshot(&screenshot, display);
+
+    glXMakeContextCurrent(display, None, None, NULL);
+    glXDestroyContext(display, context);
+    glXDestroyPbuffer(display, pbuffer);
+    return 0;
+}
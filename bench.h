@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdbool.h>
+#include <X11/Xlib.h>
+
+typedef struct {
+    int width;             // Render target size, 0 uses the root window size
+    int height;
+    bool capture;          // Benchmark a capture of the root window instead of a synthetic image
+    int frames;            // Measured frames per scenario
+} BenchOptions;
+
+int run_bench(Display* display, const BenchOptions* options);
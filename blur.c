@@ -0,0 +1,212 @@
+#include "blur.h"
+#include <stdio.h>
+
+#define MAX_BLUR_TAPS 16
+
+static const char* blur_vertex_source =
+    "#version 130\n"
+    "out vec2 uv;\n"
+    "void main() {\n"
+    "    // Single triangle covering the viewport, no vertex buffers needed\n"
+    "    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+    "    uv = p;\n"
+    "    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+static const char* blur_fragment_source =
+    "#version 130\n"
+    "in vec2 uv;\n"
+    "out vec4 color;\n"
+    "uniform sampler2D image;\n"
+    "uniform vec2 direction;\n"
+    "uniform float sigma;\n"
+    "uniform int taps;\n"
+    "uniform float flipY;\n"
+    "uniform vec2 uvOffset;\n"
+    "uniform vec2 uvScale;\n"
+    "void main() {\n"
+    "    vec2 p = uvOffset + uvScale * vec2(uv.x, mix(uv.y, 1.0 - uv.y, flipY));\n"
+    "    vec4 sum = texture(image, p);\n"
+    "    float total = 1.0;\n"
+    "    for (int i = 1; i <= taps; i++) {\n"
+    "        float w = exp(-float(i * i) / (2.0 * sigma * sigma));\n"
+    "        sum += (texture(image, p + direction * float(i)) +\n"
+    "                texture(image, p - direction * float(i))) * w;\n"
+    "        total += 2.0 * w;\n"
+    "    }\n"
+    "    color = sum / total;\n"
+    "}\n";
+
+static GLuint blur_program = 0;
+static GLuint blur_vao = 0;
+static GLuint linear_sampler = 0;
+static int blur_users = 0;
+
+static GLuint compile_blur_shader(const char* source, GLenum type) {
+    GLuint id = glCreateShader(type);
+    glShaderSource(id, 1, &source, NULL);
+    glCompileShader(id);
+
+    GLint success;
+    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char log[512];
+        glGetShaderInfoLog(id, sizeof(log), NULL, log);
+        fprintf(stderr, "Blur shader compilation error:\n%s\n", log);
+    }
+
+    return id;
+}
+
+static void acquire_blur_program(void) {
+    if (blur_users++ > 0) {
+        return;
+    }
+
+    GLuint vs = compile_blur_shader(blur_vertex_source, GL_VERTEX_SHADER);
+    GLuint fs = compile_blur_shader(blur_fragment_source, GL_FRAGMENT_SHADER);
+
+    blur_program = glCreateProgram();
+    glAttachShader(blur_program, vs);
+    glAttachShader(blur_program, fs);
+    glLinkProgram(blur_program);
+
+    GLint success;
+    glGetProgramiv(blur_program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char log[512];
+        glGetProgramInfoLog(blur_program, sizeof(log), NULL, log);
+        fprintf(stderr, "Blur shader linking error:\n%s\n", log);
+    }
+
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    glGenVertexArrays(1, &blur_vao);
+
+    // Screenshot tiles are sampled with GL_NEAREST, the downsample wants a 2x2 average
+    glGenSamplers(1, &linear_sampler);
+    glSamplerParameteri(linear_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(linear_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(linear_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(linear_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+static void release_blur_program(void) {
+    if (--blur_users > 0) {
+        return;
+    }
+
+    glDeleteProgram(blur_program);
+    glDeleteVertexArrays(1, &blur_vao);
+    glDeleteSamplers(1, &linear_sampler);
+    blur_program = 0;
+}
+
+void create_blur(Blur* blur, int source_width, int source_height, float radius) {
+    acquire_blur_program();
+
+    blur->width = source_width > 1 ? source_width / 2 : 1;
+    blur->height = source_height > 1 ? source_height / 2 : 1;
+    blur->radius = radius;
+
+    glGenTextures(3, blur->texture);
+    glGenFramebuffers(3, blur->fbo);
+    for (int i = 0; i < 3; i++) {
+        glBindTexture(GL_TEXTURE_2D, blur->texture[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, blur->width, blur->height, 0,
+                     GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, blur->fbo[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                               blur->texture[i], 0);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void destroy_blur(Blur* blur) {
+    glDeleteFramebuffers(3, blur->fbo);
+    glDeleteTextures(3, blur->texture);
+    release_blur_program();
+}
+
+static void blur_pass(GLuint target, GLuint source, float dx, float dy, float sigma, int taps) {
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glBindTexture(GL_TEXTURE_2D, source);
+    glUniform2f(glGetUniformLocation(blur_program, "direction"), dx, dy);
+    glUniform1f(glGetUniformLocation(blur_program, "sigma"), sigma);
+    glUniform1i(glGetUniformLocation(blur_program, "taps"), taps);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+static void use_blur_program(float flip_y, float u0, float v0, float u1, float v1) {
+    glUseProgram(blur_program);
+    glBindVertexArray(blur_vao);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(blur_program, "image"), 0);
+    glUniform1f(glGetUniformLocation(blur_program, "flipY"), flip_y);
+    glUniform2f(glGetUniformLocation(blur_program, "uvOffset"), u0, v0);
+    glUniform2f(glGetUniformLocation(blur_program, "uvScale"), u1 - u0, v1 - v0);
+}
+
+// Downsample one part of the screenshot into the blur's copy of it. Only the
+// parts that changed need to be fed in again, call update_blur() once all are in.
+void add_blur_source(Blur* blur, const BlurSource* source) {
+    GLint viewport[4];
+    GLint framebuffer;
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+
+    int x0 = (int)(source->x0 * blur->width + 0.5f);
+    int y0 = (int)(source->y0 * blur->height + 0.5f);
+    int x1 = (int)(source->x1 * blur->width + 0.5f);
+    int y1 = (int)(source->y1 * blur->height + 0.5f);
+
+    glViewport(x0, y0, x1 - x0, y1 - y0);
+    use_blur_program(0.0f, source->u0, source->v0, source->u1, source->v1);
+
+    glBindSampler(0, linear_sampler);
+    blur_pass(blur->fbo[BLUR_SOURCE], source->texture, 0.0f, 0.0f, 1.0f, 0);
+    glBindSampler(0, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// Blur the downsampled screenshot into the result, call after every capture
+void update_blur(Blur* blur) {
+    // Radius is in screenshot pixels, the passes run at half resolution
+    float sigma = blur->radius * 0.3f * 0.5f;
+    int taps = (int)(sigma * 3.0f + 0.5f);
+    if (taps > MAX_BLUR_TAPS) taps = MAX_BLUR_TAPS;
+
+    GLint viewport[4];
+    GLint framebuffer;
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+
+    glViewport(0, 0, blur->width, blur->height);
+    use_blur_program(0.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
+    blur_pass(blur->fbo[BLUR_HORIZONTAL], blur->texture[BLUR_SOURCE], 1.0f / blur->width, 0.0f, sigma, taps);
+    blur_pass(blur->fbo[BLUR_RESULT], blur->texture[BLUR_HORIZONTAL], 0.0f, 1.0f / blur->height, sigma, taps);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// Stretch the cached blur over the whole current viewport
+void draw_blur(const Blur* blur) {
+    use_blur_program(1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+    glBindTexture(GL_TEXTURE_2D, blur->texture[BLUR_RESULT]);
+    glUniform1i(glGetUniformLocation(blur_program, "taps"), 0);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+size_t blur_memory(const Blur* blur) {
+    return (size_t)blur->width * blur->height * 4 * 3;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <GL/glew.h>
+
+#define BLUR_RESULT 0
+#define BLUR_HORIZONTAL 1
+#define BLUR_SOURCE 2
+
+// Gaussian blur of the screenshot, computed once per capture with two
+// separable passes at half resolution and cached in a texture. The
+// downsampled screenshot is kept, so a refresh only redraws what changed.
+typedef struct {
+    GLuint fbo[3];
+    GLuint texture[3];  // Indexed by BLUR_RESULT, BLUR_HORIZONTAL and BLUR_SOURCE
+    int width;
+    int height;
+    float radius;
+} Blur;
+
+// Piece of the screenshot to downsample into the blur: where it lands, as a
+// fraction of the blur with the top row first, and which part of the texture to read
+typedef struct {
+    GLuint texture;
+    float x0, y0, x1, y1;
+    float u0, v0, u1, v1;
+} BlurSource;
+
+void create_blur(Blur* blur, int source_width, int source_height, float radius);
+void destroy_blur(Blur* blur);
+void add_blur_source(Blur* blur, const BlurSource* source);
+void update_blur(Blur* blur);
+void draw_blur(const Blur* blur);
+size_t blur_memory(const Blur* blur);
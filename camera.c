@@ -39,3 +39,13 @@ void update_camera(Camera *camera, float dt, const Mouse *mouse, Vec2f window_si
     camera->position.y += (camera->target_position.y - camera->position.y) *
                           config.camera_position_lerp_speed * dt;
 }
+
+// True when update_camera() would not visibly move the camera anymore
+bool camera_is_idle(const Camera *camera, const Mouse *mouse) {
+    if (fabsf(camera->target_scale - camera->scale) > 0.001f) return false;
+    if (fabsf(camera->delta_scale) > 0.5f) return false;
+    if (!mouse->drag && vec2_length(camera->velocity) > VELOCITY_THRESHOLD) return false;
+
+    Vec2f remaining = vec2_sub(camera->target_position, camera->position);
+    return vec2_length(remaining) * camera->scale < SETTLE_THRESHOLD;
+}
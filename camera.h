@@ -5,6 +5,8 @@
 #include "la.h"
 
 #define VELOCITY_THRESHOLD 15.0f
+// Remaining lerp distance, in screen pixels, below which the camera counts as settled
+#define SETTLE_THRESHOLD 0.5f
 
 typedef struct {
     Vec2f curr;
@@ -24,3 +26,4 @@ typedef struct {
 
 Vec2f world(const Camera* camera, Vec2f v);
 void update_camera(Camera *camera, float dt, const Mouse *mouse, Vec2f window_size);
+bool camera_is_idle(const Camera *camera, const Mouse *mouse);
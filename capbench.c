@@ -0,0 +1,227 @@
+#define _POSIX_C_SOURCE 200809L
+
+// Capture path microbenchmark. Times a fresh XGetImage per capture, an
+// XGetSubImage refresh into an existing image and a MIT-SHM refresh, both
+// through screenshot.c, for the full screen, every active monitor and a few
+// small regions. Prints latency percentiles and throughput as JSON.
+
+#include "screenshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <X11/extensions/Xrandr.h>
+
+#ifndef MITSHM
+#error "capbench compares against MIT-SHM, build it with -DMITSHM"
+#endif
+
+#define CAPBENCH_WARMUP 10
+#define MAX_AREAS 16
+
+typedef struct {
+    char name[32];
+    int x;
+    int y;
+    int width;
+    int height;
+} Area;
+
+typedef enum {
+    METHOD_GET_IMAGE,
+    METHOD_GET_SUB_IMAGE,
+    METHOD_SHM,
+    METHOD_COUNT
+} Method;
+
+static const char* method_names[METHOD_COUNT] = {
+    [METHOD_GET_IMAGE]     = "xgetimage",
+    [METHOD_GET_SUB_IMAGE] = "xgetsubimage",
+    [METHOD_SHM]           = "shm",
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, int count, double p) {
+    int index = (int)(p * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+static void add_area(Area* areas, int* count, const char* name, int x, int y, int width, int height) {
+    if (*count >= MAX_AREAS || width <= 0 || height <= 0) {
+        return;
+    }
+    Area* area = &areas[(*count)++];
+    snprintf(area->name, sizeof(area->name), "%s", name);
+    area->x = x;
+    area->y = y;
+    area->width = width;
+    area->height = height;
+}
+
+// Full screen, one area per active CRTC, then centered squares of shrinking size
+static int collect_areas(Display* display, Window root, Area* areas) {
+    int count = 0;
+    int screen = DefaultScreen(display);
+    int screen_width = DisplayWidth(display, screen);
+    int screen_height = DisplayHeight(display, screen);
+
+    add_area(areas, &count, "full", 0, 0, screen_width, screen_height);
+
+    XRRScreenResources* resources = XRRGetScreenResourcesCurrent(display, root);
+    if (resources) {
+        for (int i = 0; i < resources->ncrtc; i++) {
+            XRRCrtcInfo* crtc = XRRGetCrtcInfo(display, resources, resources->crtcs[i]);
+            if (crtc && crtc->mode != None) {
+                char name[32];
+                snprintf(name, sizeof(name), "crtc-%d", i);
+                add_area(areas, &count, name, crtc->x, crtc->y, crtc->width, crtc->height);
+            }
+            if (crtc) XRRFreeCrtcInfo(crtc);
+        }
+        XRRFreeScreenResources(resources);
+    }
+
+    static const int region_sizes[] = {512, 128, 32};
+    for (size_t i = 0; i < sizeof(region_sizes) / sizeof(region_sizes[0]); i++) {
+        int size = region_sizes[i];
+        if (size > screen_width || size > screen_height) continue;
+
+        char name[32];
+        snprintf(name, sizeof(name), "region-%d", size);
+        add_area(areas, &count, name, (screen_width - size) / 2, (screen_height - size) / 2,
+                 size, size);
+    }
+
+    return count;
+}
+
+// Time `iterations` captures of one area with one method, samples in milliseconds.
+// Returns false when the method is unavailable on this display.
+static bool measure(Display* display, Window root, const Area* area, Method method,
+                    double* samples, int iterations) {
+    Screenshot screenshot = {0};
+
+    if (method == METHOD_SHM) {
+        screenshot = create_screenshot_area(display, root, area->x, area->y,
+                                            area->width, area->height);
+        if (!screenshot.use_shm) {
+            destroy_screenshot(&screenshot, display);
+            return false;
+        }
+    } else if (method == METHOD_GET_SUB_IMAGE) {
+        // A plain XImage makes refresh_screenshot() take the XGetSubImage path
+        screenshot = (Screenshot){.x = area->x, .y = area->y, .fixed_area = true};
+        screenshot.image = XGetImage(display, root, area->x, area->y,
+                                     area->width, area->height, AllPlanes, ZPixmap);
+    }
+
+    for (int i = -CAPBENCH_WARMUP; i < iterations; i++) {
+        double start = now_seconds();
+
+        if (method == METHOD_GET_IMAGE) {
+            XImage* image = XGetImage(display, root, area->x, area->y,
+                                      area->width, area->height, AllPlanes, ZPixmap);
+            if (image) XDestroyImage(image);
+        } else {
+            refresh_screenshot(&screenshot, display, root);
+        }
+
+        double elapsed = now_seconds() - start;
+        if (i >= 0) {
+            samples[i] = elapsed * 1000.0;
+        }
+    }
+
+    destroy_screenshot(&screenshot, display);
+    return true;
+}
+
+static void print_usage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("Options:\n");
+    printf("  -n, --iterations <n>   captures per area and method (default: 200)\n");
+    printf("  -h, --help             show this help message\n");
+}
+
+int main(int argc, char** argv) {
+    int iterations = 200;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--iterations") == 0) {
+            if (i + 1 < argc) {
+                iterations = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (iterations < 1) iterations = 1;
+
+    Display* display = XOpenDisplay(NULL);
+    if (!display) {
+        fprintf(stderr, "Failed to open display\n");
+        return 1;
+    }
+    Window root = DefaultRootWindow(display);
+
+    Area areas[MAX_AREAS];
+    int area_count = collect_areas(display, root, areas);
+    double* samples = malloc(iterations * sizeof(double));
+
+    printf("{\n");
+    printf("  \"display\": \"%s\",\n", DisplayString(display));
+    printf("  \"depth\": %d,\n", DefaultDepth(display, DefaultScreen(display)));
+    printf("  \"iterations\": %d,\n", iterations);
+    printf("  \"results\": [");
+
+    bool first = true;
+    for (int a = 0; a < area_count; a++) {
+        const Area* area = &areas[a];
+        for (int m = 0; m < METHOD_COUNT; m++) {
+            if (!measure(display, root, area, m, samples, iterations)) {
+                fprintf(stderr, "%s: %s is not available, skipping\n", area->name, method_names[m]);
+                continue;
+            }
+
+            double total = 0.0;
+            for (int i = 0; i < iterations; i++) total += samples[i];
+            qsort(samples, iterations, sizeof(double), compare_doubles);
+
+            double mean = total / iterations;
+            double megabytes = (double)area->width * area->height * 4 / (1024.0 * 1024.0);
+
+            printf("%s\n    {\"area\": \"%s\", \"x\": %d, \"y\": %d, \"width\": %d, \"height\": %d, "
+                   "\"method\": \"%s\", \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p90_ms\": %.4f, "
+                   "\"p99_ms\": %.4f, \"max_ms\": %.4f, \"mb_per_s\": %.1f}",
+                   first ? "" : ",", area->name, area->x, area->y, area->width, area->height,
+                   method_names[m], mean,
+                   percentile(samples, iterations, 0.50), percentile(samples, iterations, 0.90),
+                   percentile(samples, iterations, 0.99), samples[iterations - 1],
+                   megabytes / (mean / 1000.0));
+            fflush(stdout);
+            first = false;
+        }
+    }
+
+    printf("\n  ]\n}\n");
+
+    free(samples);
+    XCloseDisplay(display);
+    return 0;
+}
@@ -0,0 +1,355 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "clipboard.h"
+#include "export.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <X11/Xatom.h>
+
+#define MAX_TRANSFERS 8
+#define MAX_CHUNK_SIZE (256 * 1024)
+
+extern char** environ;
+
+// Layout of the region handed to the owner process, the rows follow
+typedef struct {
+    int width, height;
+    int depth;
+    int bits_per_pixel;
+    int bytes_per_line;
+    int byte_order;
+    int bitmap_unit;
+    int bitmap_bit_order;
+    int bitmap_pad;
+    unsigned long red_mask, green_mask, blue_mask;
+} ClipboardImage;
+
+typedef struct {
+    Atom target;
+    ExportFormat format;
+    char* data;  // Encoded on the first request for the target
+    size_t size;
+} ClipboardFormat;
+
+// An INCR transfer in progress, advanced every time the requestor deletes the property
+typedef struct {
+    bool active;
+    Window requestor;
+    Atom property;
+    const ClipboardFormat* format;
+    size_t offset;
+} Transfer;
+
+typedef struct {
+    Display* display;
+    Window window;
+    Time owned_since;
+    Atom clipboard, targets, timestamp, incr;
+
+    XImage image;  // Private copy of the region, the capture may be refreshed meanwhile
+    ClipboardFormat formats[2];
+    size_t chunk_size;
+    Transfer transfers[MAX_TRANSFERS];
+    bool owner;
+} ClipboardOwner;
+
+// Requestors can disappear mid transfer, their errors are not ours to die of
+static int ignore_errors(Display* display, XErrorEvent* error) {
+    (void)display;
+    (void)error;
+    return 0;
+}
+
+static bool encode_format(ClipboardOwner* owner, ClipboardFormat* format) {
+    if (format->data) return true;
+
+    FILE* out = open_memstream(&format->data, &format->size);
+    if (!out) return false;
+    bool ok = export_image(&owner->image, 0, 0, owner->image.width, owner->image.height,
+                           format->format, out);
+    fclose(out);
+    if (!ok) {
+        free(format->data);
+        format->data = NULL;
+        format->size = 0;
+    }
+    return ok;
+}
+
+static void send_chunk(ClipboardOwner* owner, Transfer* transfer) {
+    size_t remaining = transfer->format->size - transfer->offset;
+    size_t length = remaining < owner->chunk_size ? remaining : owner->chunk_size;
+
+    // The empty chunk after the last one tells the requestor the transfer is done
+    XChangeProperty(owner->display, transfer->requestor, transfer->property, transfer->format->target,
+                    8, PropModeReplace, (const unsigned char*)transfer->format->data + transfer->offset,
+                    (int)length);
+    transfer->offset += length;
+    if (length == 0) {
+        XSelectInput(owner->display, transfer->requestor, NoEventMask);
+        transfer->active = false;
+    }
+}
+
+static bool start_transfer(ClipboardOwner* owner, Window requestor, Atom property, const ClipboardFormat* format) {
+    for (int i = 0; i < MAX_TRANSFERS; i++) {
+        Transfer* transfer = &owner->transfers[i];
+        if (transfer->active) continue;
+
+        *transfer = (Transfer){
+            .active = true,
+            .requestor = requestor,
+            .property = property,
+            .format = format,
+        };
+        XSelectInput(owner->display, requestor, PropertyChangeMask);
+        long size = (long)format->size;
+        XChangeProperty(owner->display, requestor, property, owner->incr, 32, PropModeReplace,
+                        (const unsigned char*)&size, 1);
+        return true;
+    }
+    return false;
+}
+
+static void handle_request(ClipboardOwner* owner, const XSelectionRequestEvent* request) {
+    Display* display = owner->display;
+    // Obsolete clients leave the property out and expect the target name to be used
+    Atom property = request->property != None ? request->property : request->target;
+    bool handled = false;
+
+    if (request->target == owner->targets) {
+        Atom targets[] = {owner->targets, owner->timestamp, owner->formats[0].target, owner->formats[1].target};
+        XChangeProperty(display, request->requestor, property, XA_ATOM, 32, PropModeReplace,
+                        (const unsigned char*)targets, sizeof(targets) / sizeof(targets[0]));
+        handled = true;
+    } else if (request->target == owner->timestamp) {
+        long time = (long)owner->owned_since;
+        XChangeProperty(display, request->requestor, property, XA_INTEGER, 32, PropModeReplace,
+                        (const unsigned char*)&time, 1);
+        handled = true;
+    } else {
+        for (int i = 0; i < 2; i++) {
+            ClipboardFormat* format = &owner->formats[i];
+            if (request->target != format->target || !encode_format(owner, format)) continue;
+
+            if (format->size <= owner->chunk_size) {
+                XChangeProperty(display, request->requestor, property, format->target, 8,
+                                PropModeReplace, (const unsigned char*)format->data, (int)format->size);
+                handled = true;
+            } else {
+                handled = start_transfer(owner, request->requestor, property, format);
+            }
+        }
+    }
+
+    XSelectionEvent reply = {
+        .type = SelectionNotify,
+        .display = display,
+        .requestor = request->requestor,
+        .selection = request->selection,
+        .target = request->target,
+        .property = handled ? property : None,
+        .time = request->time,
+    };
+    XSendEvent(display, request->requestor, False, NoEventMask, (XEvent*)&reply);
+    XFlush(display);
+}
+
+static void handle_property(ClipboardOwner* owner, const XPropertyEvent* event) {
+    if (event->state != PropertyDelete) return;
+
+    for (int i = 0; i < MAX_TRANSFERS; i++) {
+        Transfer* transfer = &owner->transfers[i];
+        if (transfer->active && transfer->requestor == event->window && transfer->property == event->atom) {
+            send_chunk(owner, transfer);
+            XFlush(owner->display);
+        }
+    }
+}
+
+static bool transfers_pending(const ClipboardOwner* owner) {
+    for (int i = 0; i < MAX_TRANSFERS; i++) {
+        if (owner->transfers[i].active) return true;
+    }
+    return false;
+}
+
+// Entry point of the owner process, `in` holds the region written by
+// copy_image_to_clipboard(). Runs until another client takes the clipboard.
+int serve_clipboard(FILE* in) {
+    ClipboardOwner owner = {0};
+
+    ClipboardImage header;
+    if (fread(&header, sizeof(header), 1, in) != 1) return 1;
+    size_t size = (size_t)header.bytes_per_line * header.height;
+    owner.image = (XImage){
+        .width = header.width,
+        .height = header.height,
+        .format = ZPixmap,
+        .byte_order = header.byte_order,
+        .bitmap_unit = header.bitmap_unit,
+        .bitmap_bit_order = header.bitmap_bit_order,
+        .bitmap_pad = header.bitmap_pad,
+        .depth = header.depth,
+        .bytes_per_line = header.bytes_per_line,
+        .bits_per_pixel = header.bits_per_pixel,
+        .red_mask = header.red_mask,
+        .green_mask = header.green_mask,
+        .blue_mask = header.blue_mask,
+    };
+    owner.image.data = malloc(size);
+    if (!owner.image.data || fread(owner.image.data, 1, size, in) != size || !XInitImage(&owner.image)) {
+        return 1;
+    }
+
+    owner.display = XOpenDisplay(NULL);
+    if (!owner.display) return 1;
+    Display* display = owner.display;
+    XSetErrorHandler(ignore_errors);
+
+    owner.clipboard = XInternAtom(display, "CLIPBOARD", False);
+    owner.targets = XInternAtom(display, "TARGETS", False);
+    owner.timestamp = XInternAtom(display, "TIMESTAMP", False);
+    owner.incr = XInternAtom(display, "INCR", False);
+    owner.formats[0] = (ClipboardFormat){.target = XInternAtom(display, "image/png", False), .format = EXPORT_PNG};
+    owner.formats[1] = (ClipboardFormat){.target = XInternAtom(display, "image/x-portable-pixmap", False), .format = EXPORT_PPM};
+
+    // Properties are limited by the maximum request size, larger images go INCR
+    long max_request = XExtendedMaxRequestSize(display);
+    if (max_request == 0) max_request = XMaxRequestSize(display);
+    owner.chunk_size = (size_t)max_request * 4 / 2;
+    if (owner.chunk_size > MAX_CHUNK_SIZE) owner.chunk_size = MAX_CHUNK_SIZE;
+
+    owner.window = XCreateSimpleWindow(display, DefaultRootWindow(display), 0, 0, 1, 1, 0, 0, 0);
+    XSelectInput(display, owner.window, PropertyChangeMask);
+
+    // Ownership wants a real timestamp, a zero length append produces one
+    XEvent event;
+    XChangeProperty(display, owner.window, XA_WM_NAME, XA_STRING, 8, PropModeAppend, NULL, 0);
+    XWindowEvent(display, owner.window, PropertyChangeMask, &event);
+    owner.owned_since = event.xproperty.time;
+
+    XSetSelectionOwner(display, owner.clipboard, owner.window, owner.owned_since);
+    owner.owner = XGetSelectionOwner(display, owner.clipboard) == owner.window;
+    if (!owner.owner) {
+        XCloseDisplay(display);
+        return 1;
+    }
+
+    // PNG is what almost every client asks for, have it ready for the first paste
+    encode_format(&owner, &owner.formats[0]);
+
+    while (owner.owner || transfers_pending(&owner)) {
+        XNextEvent(display, &event);
+        switch (event.type) {
+        case SelectionRequest:
+            handle_request(&owner, &event.xselectionrequest);
+            break;
+        case SelectionClear:
+            owner.owner = false;
+            break;
+        case PropertyNotify:
+            handle_property(&owner, &event.xproperty);
+            break;
+        }
+    }
+
+    XCloseDisplay(display);
+    return 0;
+}
+
+// Copy the region into an unlinked temporary file, rewound for reading
+static FILE* write_region(const XImage* image, int x, int y, int width, int height) {
+    FILE* file = tmpfile();
+    if (!file) return NULL;
+
+    size_t offset = (size_t)x * image->bits_per_pixel / 8;
+    ClipboardImage header = {
+        .width = width,
+        .height = height,
+        .depth = image->depth,
+        .bits_per_pixel = image->bits_per_pixel,
+        .bytes_per_line = (int)(image->bytes_per_line - offset),
+        .byte_order = image->byte_order,
+        .bitmap_unit = image->bitmap_unit,
+        .bitmap_bit_order = image->bitmap_bit_order,
+        .bitmap_pad = image->bitmap_pad,
+        .red_mask = image->red_mask,
+        .green_mask = image->green_mask,
+        .blue_mask = image->blue_mask,
+    };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int row = 0; ok && row < height; row++) {
+        const char* data = image->data + (size_t)(y + row) * image->bytes_per_line + offset;
+        ok = fwrite(data, 1, header.bytes_per_line, file) == (size_t)header.bytes_per_line;
+    }
+    if (!ok || fflush(file) != 0 || lseek(fileno(file), 0, SEEK_SET) != 0) {
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+// Hand the region to a detached process that owns CLIPBOARD until another
+// client takes it over, so the copy outlives zoomer and never stalls a frame.
+// The owner is zoomer itself started with --serve-clipboard, the region on
+// its stdin. The caller only waits for the intermediate fork to exit.
+bool copy_image_to_clipboard(const XImage* image, int x, int y, int width, int height) {
+    if (x < 0) { width += x; x = 0; }
+    if (y < 0) { height += y; y = 0; }
+    if (x + width > image->width) width = image->width - x;
+    if (y + height > image->height) height = image->height - y;
+    if (width <= 0 || height <= 0) {
+        fprintf(stderr, "Nothing to copy, the region is outside the screenshot\n");
+        return false;
+    }
+
+    FILE* region = write_region(image, x, y, width, height);
+    if (!region) {
+        perror("Could not buffer the region for the clipboard");
+        return false;
+    }
+
+    // Everything the children need is prepared here, between fork and exec
+    // other threads may hold locks, so only async-signal-safe calls follow
+    char* const argv[] = {"zoomer", "--serve-clipboard", NULL};
+    int region_fd = fileno(region);
+    long max_fd = sysconf(_SC_OPEN_MAX);
+    if (max_fd < 0) max_fd = 1024;
+
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        fclose(region);
+        return false;
+    }
+
+    if (child == 0) {
+        // Forking again reparents the owner to init, nobody has to reap it
+        setsid();
+        if (fork() != 0) {
+            _exit(0);
+        }
+        // Keep no pipe, socket or X connection of ours open, whoever waits
+        // for their EOF would otherwise wait until the clipboard changes
+        int null = open("/dev/null", O_RDWR);
+        if (null < 0 || dup2(region_fd, STDIN_FILENO) < 0 ||
+            dup2(null, STDOUT_FILENO) < 0 || dup2(null, STDERR_FILENO) < 0) {
+            _exit(1);
+        }
+        for (int fd = STDERR_FILENO + 1; fd < max_fd; fd++) {
+            close(fd);
+        }
+        execve("/proc/self/exe", argv, environ);
+        _exit(127);
+    }
+
+    fclose(region);
+    int status;
+    waitpid(child, &status, 0);
+    return true;
+}
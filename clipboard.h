@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+bool copy_image_to_clipboard(const XImage* image, int x, int y, int width, int height);
+int serve_clipboard(FILE* in);
@@ -0,0 +1,260 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "colorstats.h"
+#include "pixfmt.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define DOMINANT_BITS 4
+#define DOMINANT_BUCKETS (1 << (3 * DOMINANT_BITS))
+#define MAX_STATS_THREADS 8
+#define MIN_PIXELS_PER_THREAD (256 * 1024)
+
+// Totals for one horizontal strip of the selection, merged once all strips are done
+typedef struct {
+    const XImage* image;
+    const PixelFormat* format;
+    int x, y0, y1, width;
+
+    pthread_t thread;
+    bool threaded;
+
+    uint64_t sum[3];
+    unsigned char min[3];
+    unsigned char max[3];
+    uint32_t histogram[3][256];
+    uint32_t buckets[DOMINANT_BUCKETS];
+} Strip;
+
+Rgb8 image_color_at(const XImage* image, int x, int y) {
+    PixelFormat format = describe_pixels(image);
+    uint32_t pixel;
+    convert_pixels(&format, image, x, y, 1, &pixel);
+    return (Rgb8){(pixel >> 16) & 0xFF, (pixel >> 8) & 0xFF, pixel & 0xFF};
+}
+
+static inline void count_pixel(Strip* strip, unsigned char r, unsigned char g, unsigned char b) {
+    strip->histogram[0][r]++;
+    strip->histogram[1][g]++;
+    strip->histogram[2][b]++;
+
+    int shift = 8 - DOMINANT_BITS;
+    strip->buckets[((r >> shift) << (2 * DOMINANT_BITS)) | ((g >> shift) << DOMINANT_BITS) | (b >> shift)]++;
+}
+
+static inline void add_pixel(Strip* strip, unsigned char r, unsigned char g, unsigned char b) {
+    strip->sum[0] += r;
+    strip->sum[1] += g;
+    strip->sum[2] += b;
+    if (r < strip->min[0]) strip->min[0] = r;
+    if (g < strip->min[1]) strip->min[1] = g;
+    if (b < strip->min[2]) strip->min[2] = b;
+    if (r > strip->max[0]) strip->max[0] = r;
+    if (g > strip->max[1]) strip->max[1] = g;
+    if (b > strip->max[2]) strip->max[2] = b;
+    count_pixel(strip, r, g, b);
+}
+
+#ifdef __SSE2__
+// Four pixels per step: sums with SAD against zero on one channel at a time,
+// min and max bytewise on all channels at once. Histograms stay scalar.
+static void accumulate_row(Strip* strip, const uint32_t* row, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i low_byte = _mm_set1_epi32(0xFF);
+    __m128i sum_r = zero, sum_g = zero, sum_b = zero;
+    __m128i vmin = _mm_set1_epi8((char)0xFF);
+    __m128i vmax = zero;
+
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + i));
+        sum_b = _mm_add_epi64(sum_b, _mm_sad_epu8(_mm_and_si128(v, low_byte), zero));
+        sum_g = _mm_add_epi64(sum_g, _mm_sad_epu8(_mm_and_si128(_mm_srli_epi32(v, 8), low_byte), zero));
+        sum_r = _mm_add_epi64(sum_r, _mm_sad_epu8(_mm_and_si128(_mm_srli_epi32(v, 16), low_byte), zero));
+        vmin = _mm_min_epu8(vmin, v);
+        vmax = _mm_max_epu8(vmax, v);
+
+        for (int k = 0; k < 4; k++) {
+            uint32_t p = row[i + k];
+            count_pixel(strip, (p >> 16) & 0xFF, (p >> 8) & 0xFF, p & 0xFF);
+        }
+    }
+    for (; i < width; i++) {
+        uint32_t p = row[i];
+        add_pixel(strip, (p >> 16) & 0xFF, (p >> 8) & 0xFF, p & 0xFF);
+    }
+
+    uint64_t sums[3][2];
+    _mm_storeu_si128((__m128i*)sums[0], sum_r);
+    _mm_storeu_si128((__m128i*)sums[1], sum_g);
+    _mm_storeu_si128((__m128i*)sums[2], sum_b);
+    for (int c = 0; c < 3; c++) {
+        strip->sum[c] += sums[c][0] + sums[c][1];
+    }
+
+    if (width < 4) return;
+    unsigned char mins[16], maxs[16];
+    _mm_storeu_si128((__m128i*)mins, vmin);
+    _mm_storeu_si128((__m128i*)maxs, vmax);
+    for (int k = 0; k < 16; k += 4) {
+        // Little endian 0x00RRGGBB is stored B, G, R, X
+        for (int c = 0; c < 3; c++) {
+            if (mins[k + 2 - c] < strip->min[c]) strip->min[c] = mins[k + 2 - c];
+            if (maxs[k + 2 - c] > strip->max[c]) strip->max[c] = maxs[k + 2 - c];
+        }
+    }
+}
+#else
+static void accumulate_row(Strip* strip, const uint32_t* row, int width) {
+    for (int i = 0; i < width; i++) {
+        uint32_t p = row[i];
+        add_pixel(strip, (p >> 16) & 0xFF, (p >> 8) & 0xFF, p & 0xFF);
+    }
+}
+#endif
+
+// 0x00RRGGBB images are read in place, anything else one converted row at a time
+static void* strip_worker(void* arg) {
+    Strip* strip = arg;
+    memset(strip->min, 0xFF, sizeof(strip->min));
+
+    const XImage* image = strip->image;
+    uint32_t* converted = NULL;
+    if (strip->format->layout != PIXEL_XRGB8888) {
+        converted = malloc((size_t)strip->width * sizeof(uint32_t));
+        if (!converted) return NULL;
+    }
+
+    for (int y = strip->y0; y < strip->y1; y++) {
+        const uint32_t* row;
+        if (converted) {
+            convert_pixels(strip->format, image, strip->x, y, strip->width, converted);
+            row = converted;
+        } else {
+            row = (const uint32_t*)(image->data + (size_t)y * image->bytes_per_line) + strip->x;
+        }
+        accumulate_row(strip, row, strip->width);
+    }
+
+    free(converted);
+    return NULL;
+}
+
+static unsigned char histogram_median(const uint32_t* histogram, uint64_t count) {
+    uint64_t half = (count + 1) / 2;
+    uint64_t seen = 0;
+    for (int v = 0; v < 256; v++) {
+        seen += histogram[v];
+        if (seen >= half) return (unsigned char)v;
+    }
+    return 255;
+}
+
+// Selections of a few hundred thousand pixels or more are split into strips
+// counted on separate threads, the caller counts the first strip itself
+void compute_color_stats(const XImage* image, int x, int y, int width, int height, ColorStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    if (x < 0) { width += x; x = 0; }
+    if (y < 0) { height += y; y = 0; }
+    if (x + width > image->width) width = image->width - x;
+    if (y + height > image->height) height = image->height - y;
+    if (width <= 0 || height <= 0) return;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    long pixels = (long)width * height;
+    int strip_count = (int)(pixels / MIN_PIXELS_PER_THREAD);
+    if (strip_count > cpus) strip_count = (int)cpus;
+    if (strip_count > MAX_STATS_THREADS) strip_count = MAX_STATS_THREADS;
+    if (strip_count > height) strip_count = height;
+    if (strip_count < 1) strip_count = 1;
+
+    Strip* strips = calloc(strip_count, sizeof(Strip));
+    if (!strips) return;
+
+    PixelFormat format = describe_pixels(image);
+    for (int i = 0; i < strip_count; i++) {
+        strips[i].image = image;
+        strips[i].format = &format;
+        strips[i].x = x;
+        strips[i].width = width;
+        strips[i].y0 = y + height * i / strip_count;
+        strips[i].y1 = y + height * (i + 1) / strip_count;
+    }
+    for (int i = 1; i < strip_count; i++) {
+        strips[i].threaded = pthread_create(&strips[i].thread, NULL, strip_worker, &strips[i]) == 0;
+        if (!strips[i].threaded) {
+            strip_worker(&strips[i]);
+        }
+    }
+    strip_worker(&strips[0]);
+
+    uint64_t sum[3] = {0};
+    unsigned char min[3] = {255, 255, 255};
+    unsigned char max[3] = {0};
+    uint32_t* buckets = strips[0].buckets;
+
+    for (int i = 0; i < strip_count; i++) {
+        Strip* strip = &strips[i];
+        if (strip->threaded) {
+            pthread_join(strip->thread, NULL);
+        }
+        for (int c = 0; c < 3; c++) {
+            sum[c] += strip->sum[c];
+            if (strip->min[c] < min[c]) min[c] = strip->min[c];
+            if (strip->max[c] > max[c]) max[c] = strip->max[c];
+            for (int v = 0; v < 256; v++) {
+                stats->histogram[c][v] += strip->histogram[c][v];
+            }
+        }
+        if (i > 0) {
+            for (int b = 0; b < DOMINANT_BUCKETS; b++) {
+                buckets[b] += strip->buckets[b];
+            }
+        }
+    }
+
+    stats->count = (uint64_t)pixels;
+    stats->average = (Rgb8){
+        (unsigned char)((sum[0] + pixels / 2) / pixels),
+        (unsigned char)((sum[1] + pixels / 2) / pixels),
+        (unsigned char)((sum[2] + pixels / 2) / pixels),
+    };
+    stats->median = (Rgb8){
+        histogram_median(stats->histogram[0], stats->count),
+        histogram_median(stats->histogram[1], stats->count),
+        histogram_median(stats->histogram[2], stats->count),
+    };
+    stats->min = (Rgb8){min[0], min[1], min[2]};
+    stats->max = (Rgb8){max[0], max[1], max[2]};
+
+    for (int c = 0; c < 3; c++) {
+        for (int v = 0; v < 256; v++) {
+            if (stats->histogram[c][v] > stats->histogram_peak) {
+                stats->histogram_peak = stats->histogram[c][v];
+            }
+        }
+    }
+
+    // Report the center of the most common bucket
+    int best = 0;
+    for (int b = 1; b < DOMINANT_BUCKETS; b++) {
+        if (buckets[b] > buckets[best]) best = b;
+    }
+    int shift = 8 - DOMINANT_BITS;
+    int mask = (1 << DOMINANT_BITS) - 1;
+    int center = 1 << (shift - 1);
+    stats->dominant = (Rgb8){
+        (unsigned char)((((best >> (2 * DOMINANT_BITS)) & mask) << shift) | center),
+        (unsigned char)((((best >> DOMINANT_BITS) & mask) << shift) | center),
+        (unsigned char)(((best & mask) << shift) | center),
+    };
+
+    free(strips);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+typedef struct {
+    unsigned char r, g, b;
+} Rgb8;
+
+// Statistics over a rectangle of the screenshot. The median is taken per
+// channel, the dominant color is the most common 4 bit per channel bucket.
+typedef struct {
+    uint64_t count;
+    Rgb8 average;
+    Rgb8 median;
+    Rgb8 min;
+    Rgb8 max;
+    Rgb8 dominant;
+    uint32_t histogram[3][256];  // Red, green and blue
+    uint32_t histogram_peak;     // Largest bin of any channel, for scaling plots
+} ColorStats;
+
+Rgb8 image_color_at(const XImage* image, int x, int y);
+void compute_color_stats(const XImage* image, int x, int y, int width, int height, ColorStats* stats);
@@ -25,14 +25,20 @@ static Config default_config(void) {
         .blur_outside_flashlight = true,
         .outside_flashlight_blur_radius = 10.0f,
         .hide_cursor_on_flashlight = true,
-        .vertex_shader_path = "/etc/zoomer/vert.glsl",
-        .fragment_shader_path = "/etc/zoomer/frag.glsl",
+        .vertex_shader_path = "",
+        .fragment_shader_path = "",
         .bubble_mass = 1.0f,
         .bubble_spring_k = 80.0f,
         .bubble_damping = 8.0f,
         .bubble_stretch_factor = 0.0001f,
         .bubble_squeeze_factor = 0.5f,
         .bubble_deform_smoothing = 8.0f,
+        .vsync = true,
+        .max_frames_in_flight = 2,
+        .per_monitor = false,
+        .daemon_hotkey = "super+z",
+        .screenshot_directory = "",
+        .record_fps = 0.0f,
     };
 }
 
@@ -124,6 +130,23 @@ Config load_config(const char* filepath) {
             } else if (strcmp(k, "bubble_deform_smoothing") == 0) {
                 config.bubble_deform_smoothing = atof(v);
 
+            } else if (strcmp(k, "vsync") == 0) {
+                config.vsync = parse_bool(v);
+            } else if (strcmp(k, "max_frames_in_flight") == 0) {
+                config.max_frames_in_flight = atoi(v);
+            } else if (strcmp(k, "per_monitor") == 0) {
+                config.per_monitor = parse_bool(v);
+            } else if (strcmp(k, "daemon_hotkey") == 0) {
+                // A cut off combination would grab some other key, keep the default instead
+                if (strlen(v) >= sizeof(config.daemon_hotkey)) {
+                    fprintf(stderr, "daemon_hotkey is too long, keeping %s\n", config.daemon_hotkey);
+                } else {
+                    snprintf(config.daemon_hotkey, sizeof(config.daemon_hotkey), "%s", v);
+                }
+            } else if (strcmp(k, "screenshot_directory") == 0) {
+                strncpy(config.screenshot_directory, v, sizeof(config.screenshot_directory) - 1);
+            } else if (strcmp(k, "record_fps") == 0) {
+                config.record_fps = atof(v);
             }
         }
     }
@@ -177,9 +200,9 @@ void generate_default_config(const char* filepath) {
     fprintf(f, "blur_outside_flashlight          = %s\n", config.blur_outside_flashlight ? "true" : "false");
     fprintf(f, "outside_flashlight_blur_radius   = %f\n", config.outside_flashlight_blur_radius);
     fprintf(f, "\n");
-    fprintf(f, "# Shader Paths (leave empty to use ./vert.glsl and ./frag.glsl)\n");
-    fprintf(f, "vertex_shader_path       = /etc/zoomer/vert.glsl\n");
-    fprintf(f, "fragment_shader_path     = /etc/zoomer/frag.glsl\n");
+    fprintf(f, "# Shader Overrides (leave empty to use the built-in shaders)\n");
+    fprintf(f, "vertex_shader_path       = %s\n", config.vertex_shader_path);
+    fprintf(f, "fragment_shader_path     = %s\n", config.fragment_shader_path);
     
 
     fprintf(f, "bubble_mass =              %f\n", config.bubble_mass);
@@ -188,6 +211,20 @@ void generate_default_config(const char* filepath) {
     fprintf(f, "bubble_stretch_factor =    %f #How much velocity causes stretch\n", config.bubble_stretch_factor);
     fprintf(f, "bubble_squeeze_factor =    %f #How much perpendicular squeeze\n", config.bubble_squeeze_factor);
     fprintf(f, "bubble_deform_smoothing =  %f #Smoothing for deformation recovery\n", config.bubble_deform_smoothing);
+    fprintf(f, "\n");
+    fprintf(f, "# Frame Pacing\n");
+    fprintf(f, "vsync                    = %s\n", config.vsync ? "true" : "false");
+    fprintf(f, "max_frames_in_flight     = %d #0 disables latency limiting\n", config.max_frames_in_flight);
+    fprintf(f, "\n");
+    fprintf(f, "# Capture\n");
+    fprintf(f, "per_monitor              = %s #Only capture the monitor under the cursor\n", config.per_monitor ? "true" : "false");
+    fprintf(f, "\n");
+    fprintf(f, "# Daemon Mode (zoomer --daemon)\n");
+    fprintf(f, "daemon_hotkey            = %s\n", config.daemon_hotkey);
+    fprintf(f, "\n");
+    fprintf(f, "# Export (leave empty to save screenshots in the home directory)\n");
+    fprintf(f, "screenshot_directory     = %s\n", config.screenshot_directory);
+    fprintf(f, "record_fps               = %.0f #0 records at the screen rate\n", config.record_fps);
 
 
     fclose(f);
@@ -27,6 +27,12 @@ typedef struct {
     float bubble_stretch_factor;
     float bubble_squeeze_factor;
     float bubble_deform_smoothing;
+    bool  vsync;
+    int   max_frames_in_flight;
+    bool  per_monitor;
+    char daemon_hotkey[64];
+    char screenshot_directory[512];
+    float record_fps;
 } Config;
 
 extern Config config;
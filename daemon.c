@@ -0,0 +1,237 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "daemon.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+// Modifiers that take part in matching, lock keys are ignored
+#define HOTKEY_MODIFIERS (ShiftMask | ControlMask | Mod1Mask | Mod4Mask)
+
+// Parse "ctrl+alt+z" style key combinations
+bool parse_hotkey(Display* display, const char* spec, Hotkey* hotkey) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%s", spec);
+
+    hotkey->modifiers = 0;
+    hotkey->keycode = 0;
+
+    char* saveptr = NULL;
+    for (char* token = strtok_r(buffer, "+", &saveptr); token; token = strtok_r(NULL, "+", &saveptr)) {
+        if (strcasecmp(token, "ctrl") == 0 || strcasecmp(token, "control") == 0) {
+            hotkey->modifiers |= ControlMask;
+        } else if (strcasecmp(token, "shift") == 0) {
+            hotkey->modifiers |= ShiftMask;
+        } else if (strcasecmp(token, "alt") == 0 || strcasecmp(token, "mod1") == 0) {
+            hotkey->modifiers |= Mod1Mask;
+        } else if (strcasecmp(token, "super") == 0 || strcasecmp(token, "mod4") == 0) {
+            hotkey->modifiers |= Mod4Mask;
+        } else {
+            KeySym keysym = XStringToKeysym(token);
+            if (keysym == NoSymbol) {
+                fprintf(stderr, "Unknown key in hotkey '%s': %s\n", spec, token);
+                return false;
+            }
+            hotkey->keycode = XKeysymToKeycode(display, keysym);
+        }
+    }
+
+    if (hotkey->keycode == 0) {
+        fprintf(stderr, "Hotkey '%s' does not name a key on this keyboard\n", spec);
+        return false;
+    }
+    return true;
+}
+
+static bool grab_failed = false;
+
+static int grab_error_handler(Display* display, XErrorEvent* event) {
+    (void)display;
+    (void)event;
+    grab_failed = true;
+    return 0;
+}
+
+// Grab the key on the root window, with and without Caps Lock and Num Lock.
+// Fails when another client already holds the combination.
+bool grab_hotkey(Display* display, Window root, const Hotkey* hotkey) {
+    static const unsigned int locks[] = {0, LockMask, Mod2Mask, LockMask | Mod2Mask};
+
+    // XGrabKey fails asynchronously, so sync with a temporary handler installed
+    grab_failed = false;
+    XErrorHandler previous_handler = XSetErrorHandler(grab_error_handler);
+    for (size_t i = 0; i < sizeof(locks) / sizeof(locks[0]); i++) {
+        XGrabKey(display, hotkey->keycode, hotkey->modifiers | locks[i], root,
+                 True, GrabModeAsync, GrabModeAsync);
+    }
+    XSync(display, False);
+    XSetErrorHandler(previous_handler);
+
+    if (grab_failed) {
+        ungrab_hotkey(display, root, hotkey);
+        return false;
+    }
+    return true;
+}
+
+void ungrab_hotkey(Display* display, Window root, const Hotkey* hotkey) {
+    static const unsigned int locks[] = {0, LockMask, Mod2Mask, LockMask | Mod2Mask};
+    for (size_t i = 0; i < sizeof(locks) / sizeof(locks[0]); i++) {
+        XUngrabKey(display, hotkey->keycode, hotkey->modifiers | locks[i], root);
+    }
+}
+
+bool hotkey_matches(const Hotkey* hotkey, const XKeyEvent* event) {
+    return event->keycode == hotkey->keycode &&
+           (event->state & HOTKEY_MODIFIERS) == hotkey->modifiers;
+}
+
+// Clients that never send their request are dropped after this long
+#define CONTROL_TIMEOUT_SECONDS 2
+
+// $XDG_RUNTIME_DIR/zoomer.sock, or /tmp/zoomer-<uid>/zoomer.sock without it.
+// Anyone can create that directory first, so it is only used when it belongs
+// to us and nobody else has access. `create` makes it when missing.
+static bool control_socket_path(struct sockaddr_un* address, bool create) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+
+    const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && runtime_dir[0]) {
+        snprintf(address->sun_path, sizeof(address->sun_path), "%s/zoomer.sock", runtime_dir);
+        return true;
+    }
+
+    char directory[64];
+    snprintf(directory, sizeof(directory), "/tmp/zoomer-%d", (int)getuid());
+    if (create && mkdir(directory, 0700) < 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create %s: %s\n", directory, strerror(errno));
+        return false;
+    }
+
+    struct stat info;
+    if (lstat(directory, &info) < 0) {
+        fprintf(stderr, "Could not check %s: %s\n", directory, strerror(errno));
+        return false;
+    }
+    if (!S_ISDIR(info.st_mode) || info.st_uid != getuid() || (info.st_mode & 077) != 0) {
+        fprintf(stderr, "Refusing to use %s, it is not a private directory of this user\n", directory);
+        return false;
+    }
+
+    snprintf(address->sun_path, sizeof(address->sun_path), "%s/zoomer.sock", directory);
+    return true;
+}
+
+// Listen for activation requests, returns the socket or -1. Sets
+// `already_running` when another daemon answers on the socket.
+int open_control_socket(bool* already_running) {
+    struct sockaddr_un address;
+    *already_running = false;
+    if (!control_socket_path(&address, true)) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    // Only a socket nobody listens on anymore is taken over, it was left
+    // behind by a daemon that did not exit cleanly and blocks bind()
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0) {
+        fprintf(stderr, "zoomer is already running as a daemon on %s\n", address.sun_path);
+        *already_running = true;
+        close(fd);
+        return -1;
+    }
+    if (errno == ECONNREFUSED) {
+        unlink(address.sun_path);
+    } else if (errno != ENOENT) {
+        fprintf(stderr, "Could not check %s: %s\n", address.sun_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    // A failed connect leaves the socket unusable, start over with a fresh one
+    close(fd);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, 4) < 0) {
+        fprintf(stderr, "Failed to listen on %s\n", address.sun_path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+void close_control_socket(int fd) {
+    struct sockaddr_un address;
+    close(fd);
+    if (control_socket_path(&address, false)) {
+        unlink(address.sun_path);
+    }
+}
+
+// Accept a pending client, returns its socket or -1. Reads and writes on it
+// time out so a client that connects and goes quiet cannot hang the daemon.
+int accept_control_client(int fd) {
+    int client = accept(fd, NULL, NULL);
+    if (client < 0) {
+        return -1;
+    }
+
+    struct timeval timeout = {.tv_sec = CONTROL_TIMEOUT_SECONDS};
+    if (setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0 ||
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0) {
+        perror("setsockopt");
+        close(client);
+        return -1;
+    }
+    return client;
+}
+
+// Ask a running daemon to activate and copy its reply (e.g. a picked color)
+// to stdout. Returns the exit status for the client process.
+int send_control_message(const char* message) {
+    struct sockaddr_un address;
+    if (!control_socket_path(&address, false)) {
+        return 1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        fprintf(stderr, "No zoomer daemon is listening on %s\n", address.sun_path);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+
+    size_t length = strlen(message);
+    if (write(fd, message, length) != (ssize_t)length) {
+        perror("write");
+        close(fd);
+        return 1;
+    }
+    shutdown(fd, SHUT_WR);
+
+    char reply[256];
+    ssize_t n;
+    while ((n = read(fd, reply, sizeof(reply))) > 0) {
+        fwrite(reply, 1, n, stdout);
+    }
+
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+#include <X11/Xlib.h>
+
+// Global key combination that wakes up a resident zoomer
+typedef struct {
+    KeyCode keycode;
+    unsigned int modifiers;
+} Hotkey;
+
+bool parse_hotkey(Display* display, const char* spec, Hotkey* hotkey);
+bool grab_hotkey(Display* display, Window root, const Hotkey* hotkey);
+void ungrab_hotkey(Display* display, Window root, const Hotkey* hotkey);
+bool hotkey_matches(const Hotkey* hotkey, const XKeyEvent* event);
+
+int open_control_socket(bool* already_running);
+void close_control_socket(int fd);
+int accept_control_client(int fd);
+int send_control_message(const char* message);
@@ -0,0 +1,342 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "export.h"
+#include "pixfmt.h"
+#include "config.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define MAX_EXPORT_THREADS 16
+#define MIN_ROWS_PER_STRIP 32
+#define PNG_COMPRESSION_LEVEL 1
+
+bool parse_export_format(const char* name, ExportFormat* format) {
+    if (strcasecmp(name, "png") == 0) {
+        *format = EXPORT_PNG;
+    } else if (strcasecmp(name, "ppm") == 0) {
+        *format = EXPORT_PPM;
+    } else if (strcasecmp(name, "raw") == 0) {
+        *format = EXPORT_RAW;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Picked from the extension, anything unknown is written as PNG
+ExportFormat export_format_for_path(const char* path) {
+    ExportFormat format = EXPORT_PNG;
+    const char* dot = strrchr(path, '.');
+    if (dot) {
+        parse_export_format(dot + 1, &format);
+    }
+    return format;
+}
+
+// $screenshot_directory/zoomer-<date>-<time>.png, the home directory when unset
+void default_export_path(char* path, size_t size) {
+    const char* directory = config.screenshot_directory;
+    if (directory[0] == '\0') {
+        directory = getenv("HOME") ? getenv("HOME") : ".";
+    }
+
+    char stamp[32];
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+    snprintf(path, size, "%s/zoomer-%s.png", directory, stamp);
+}
+
+// One image row to packed RGB. 0x00RRGGBB rows are read straight out of the
+// XImage buffer, other formats are converted into `scratch` first.
+static void convert_row(const PixelFormat* format, const XImage* image, int x, int y, int width,
+                        uint32_t* scratch, unsigned char* rgb) {
+    const uint32_t* row = (const uint32_t*)(image->data + (size_t)y * image->bytes_per_line) + x;
+    if (format->layout != PIXEL_XRGB8888) {
+        convert_pixels(format, image, x, y, width, scratch);
+        row = scratch;
+    }
+
+    for (int i = 0; i < width; i++) {
+        uint32_t p = row[i];
+        rgb[3 * i + 0] = (p >> 16) & 0xFF;
+        rgb[3 * i + 1] = (p >> 8) & 0xFF;
+        rgb[3 * i + 2] = p & 0xFF;
+    }
+}
+
+static bool export_ppm(const XImage* image, int x, int y, int width, int height, FILE* out) {
+    fprintf(out, "P6\n%d %d\n255\n", width, height);
+
+    PixelFormat format = describe_pixels(image);
+    unsigned char* rgb = malloc((size_t)width * 3);
+    uint32_t* scratch = malloc((size_t)width * sizeof(uint32_t));
+
+    bool ok = rgb && scratch;
+    for (int row = 0; row < height && ok; row++) {
+        convert_row(&format, image, x, y + row, width, scratch, rgb);
+        ok = fwrite(rgb, 3, width, out) == (size_t)width;
+    }
+
+    free(scratch);
+    free(rgb);
+    return ok;
+}
+
+// Rows are written as they are in the image, no conversion at all
+static bool export_raw(const XImage* image, int x, int y, int width, int height, FILE* out) {
+    size_t bytes_per_pixel = image->bits_per_pixel / 8;
+    if (bytes_per_pixel == 0) {
+        fprintf(stderr, "Raw export needs a byte aligned visual, got %d bits per pixel\n",
+                image->bits_per_pixel);
+        return false;
+    }
+
+    for (int row = 0; row < height; row++) {
+        const char* data = image->data + (size_t)(y + row) * image->bytes_per_line + x * bytes_per_pixel;
+        if (fwrite(data, bytes_per_pixel, width, out) != (size_t)width) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A run of rows filtered and deflated on its own thread. Strips end on a
+// sync flush so their outputs concatenate into one valid zlib stream.
+typedef struct {
+    const XImage* image;
+    const PixelFormat* format;
+    int x, width;
+    int y0, y1;
+    bool first;
+    bool last;
+
+    pthread_t thread;
+    bool threaded;
+
+    unsigned char* output;
+    size_t output_size;
+    uLong adler;
+    uLong input_size;
+    bool ok;
+} PngStrip;
+
+static inline unsigned char paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return (unsigned char)a;
+    return (unsigned char)(pb <= pc ? b : c);
+}
+
+// Filter one row with Sub, Up and Paeth and keep the one with the smallest
+// sum of absolute values, the usual heuristic for picking a PNG filter
+static void filter_row(const unsigned char* row, const unsigned char* previous, size_t length,
+                       unsigned char* candidates[3], unsigned char* filtered) {
+    unsigned long cost[3] = {0};
+    for (size_t i = 0; i < length; i++) {
+        int a = i >= 3 ? row[i - 3] : 0;
+        int b = previous ? previous[i] : 0;
+        int c = i >= 3 && previous ? previous[i - 3] : 0;
+
+        unsigned char sub = row[i] - a;
+        unsigned char up = row[i] - b;
+        unsigned char pth = row[i] - paeth(a, b, c);
+        candidates[0][i] = sub;
+        candidates[1][i] = up;
+        candidates[2][i] = pth;
+        cost[0] += sub < 128 ? sub : 256 - sub;
+        cost[1] += up < 128 ? up : 256 - up;
+        cost[2] += pth < 128 ? pth : 256 - pth;
+    }
+
+    int best = 0;
+    if (cost[1] < cost[best]) best = 1;
+    if (cost[2] < cost[best]) best = 2;
+
+    static const unsigned char filter_types[3] = {1, 2, 4};
+    filtered[0] = filter_types[best];
+    memcpy(filtered + 1, candidates[best], length);
+}
+
+static void* png_strip_worker(void* arg) {
+    PngStrip* strip = arg;
+    size_t length = (size_t)strip->width * 3;
+    int rows = strip->y1 - strip->y0;
+
+    z_stream stream = {0};
+    strip->ok = deflateInit2(&stream, PNG_COMPRESSION_LEVEL, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    if (!strip->ok) return NULL;
+
+    strip->input_size = (uLong)rows * (length + 1);
+    strip->output_size = deflateBound(&stream, strip->input_size) + 16;
+    strip->output = malloc(strip->output_size);
+
+    // Two rows of RGB, the filter candidates and the filtered row with its type byte
+    unsigned char* buffer = malloc(length * 6 + 1);
+    uint32_t* scratch = malloc((size_t)strip->width * sizeof(uint32_t));
+    if (!strip->output || !buffer || !scratch) {
+        strip->ok = false;
+        free(scratch);
+        free(buffer);
+        deflateEnd(&stream);
+        return NULL;
+    }
+    unsigned char* rows_rgb[2] = {buffer, buffer + length};
+    unsigned char* candidates[3] = {buffer + 2 * length, buffer + 3 * length, buffer + 4 * length};
+    unsigned char* filtered = buffer + 5 * length;
+
+    stream.next_out = strip->output;
+    stream.avail_out = (uInt)strip->output_size;
+    strip->adler = adler32(0, NULL, 0);
+
+    // Up and Paeth look at the row above, even across the strip boundary
+    const unsigned char* previous = NULL;
+    if (!strip->first) {
+        convert_row(strip->format, strip->image, strip->x, strip->y0 - 1, strip->width, scratch, rows_rgb[1]);
+        previous = rows_rgb[1];
+    }
+
+    for (int r = 0; r < rows && strip->ok; r++) {
+        unsigned char* current = rows_rgb[r & 1];
+        convert_row(strip->format, strip->image, strip->x, strip->y0 + r, strip->width, scratch, current);
+        filter_row(current, previous, length, candidates, filtered);
+        previous = current;
+
+        strip->adler = adler32(strip->adler, filtered, (uInt)(length + 1));
+        stream.next_in = filtered;
+        stream.avail_in = (uInt)(length + 1);
+        int flush = r + 1 < rows ? Z_NO_FLUSH : (strip->last ? Z_FINISH : Z_SYNC_FLUSH);
+        int status = deflate(&stream, flush);
+        strip->ok = status == Z_OK || status == Z_STREAM_END;
+    }
+
+    strip->output_size = strip->output_size - stream.avail_out;
+    deflateEnd(&stream);
+    free(scratch);
+    free(buffer);
+    return NULL;
+}
+
+static bool write_png_chunk(FILE* out, const char* type, const unsigned char* data, size_t length) {
+    unsigned char header[8] = {
+        length >> 24, length >> 16, length >> 8, length,
+        type[0], type[1], type[2], type[3],
+    };
+    uLong crc = crc32(0, header + 4, 4);
+    if (length > 0) {
+        // crc32() restarts from zero when handed a NULL buffer
+        crc = crc32(crc, data, (uInt)length);
+    }
+    unsigned char footer[4] = {crc >> 24, crc >> 16, crc >> 8, crc};
+
+    return fwrite(header, 1, 8, out) == 8 &&
+           (length == 0 || fwrite(data, 1, length, out) == length) &&
+           fwrite(footer, 1, 4, out) == 4;
+}
+
+// Rows are split into one strip per core, filtered and deflated in parallel
+// and written as IDAT chunks in order as the strips finish
+static bool export_png(const XImage* image, int x, int y, int width, int height, FILE* out) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int strip_count = height / MIN_ROWS_PER_STRIP;
+    if (strip_count > cpus) strip_count = (int)cpus;
+    if (strip_count > MAX_EXPORT_THREADS) strip_count = MAX_EXPORT_THREADS;
+    if (strip_count < 1) strip_count = 1;
+
+    PngStrip* strips = calloc(strip_count, sizeof(PngStrip));
+    if (!strips) return false;
+
+    PixelFormat format = describe_pixels(image);
+    for (int i = 0; i < strip_count; i++) {
+        strips[i].image = image;
+        strips[i].format = &format;
+        strips[i].x = x;
+        strips[i].width = width;
+        strips[i].y0 = y + height * i / strip_count;
+        strips[i].y1 = y + height * (i + 1) / strip_count;
+        strips[i].first = i == 0;
+        strips[i].last = i == strip_count - 1;
+        strips[i].threaded = pthread_create(&strips[i].thread, NULL, png_strip_worker, &strips[i]) == 0;
+        if (!strips[i].threaded) {
+            png_strip_worker(&strips[i]);
+        }
+    }
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    unsigned char ihdr[13] = {
+        width >> 24, width >> 16, width >> 8, width,
+        height >> 24, height >> 16, height >> 8, height,
+        8, 2, 0, 0, 0,  // 8 bit RGB, deflate, adaptive filtering, no interlace
+    };
+    static const unsigned char zlib_header[2] = {0x78, 0x01};
+
+    bool ok = fwrite(signature, 1, 8, out) == 8 &&
+              write_png_chunk(out, "IHDR", ihdr, sizeof(ihdr)) &&
+              write_png_chunk(out, "IDAT", zlib_header, sizeof(zlib_header));
+
+    uLong adler = adler32(0, NULL, 0);
+    for (int i = 0; i < strip_count; i++) {
+        PngStrip* strip = &strips[i];
+        if (strip->threaded) {
+            pthread_join(strip->thread, NULL);
+        }
+        ok = ok && strip->ok && write_png_chunk(out, "IDAT", strip->output, strip->output_size);
+        adler = adler32_combine(adler, strip->adler, (z_off_t)strip->input_size);
+        free(strip->output);
+    }
+
+    unsigned char trailer[4] = {adler >> 24, adler >> 16, adler >> 8, adler};
+    ok = ok && write_png_chunk(out, "IDAT", trailer, sizeof(trailer)) &&
+         write_png_chunk(out, "IEND", NULL, 0);
+
+    free(strips);
+    return ok;
+}
+
+// Write part of the image, clamped to its bounds
+bool export_image(const XImage* image, int x, int y, int width, int height,
+                  ExportFormat format, FILE* out) {
+    if (x < 0) { width += x; x = 0; }
+    if (y < 0) { height += y; y = 0; }
+    if (x + width > image->width) width = image->width - x;
+    if (y + height > image->height) height = image->height - y;
+    if (width <= 0 || height <= 0) {
+        fprintf(stderr, "Nothing to export, the region is outside the screenshot\n");
+        return false;
+    }
+
+    bool ok = false;
+    switch (format) {
+    case EXPORT_PNG: ok = export_png(image, x, y, width, height, out); break;
+    case EXPORT_PPM: ok = export_ppm(image, x, y, width, height, out); break;
+    case EXPORT_RAW: ok = export_raw(image, x, y, width, height, out); break;
+    }
+    return fflush(out) == 0 && ok;
+}
+
+// "-" writes to stdout
+bool export_image_to_path(const XImage* image, int x, int y, int width, int height,
+                          ExportFormat format, const char* path) {
+    if (strcmp(path, "-") == 0) {
+        return export_image(image, x, y, width, height, format, stdout);
+    }
+
+    FILE* out = fopen(path, "wb");
+    if (!out) {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return false;
+    }
+    bool ok = export_image(image, x, y, width, height, format, out);
+    ok = fclose(out) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", path);
+    }
+    return ok;
+}
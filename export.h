@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+typedef enum {
+    EXPORT_PNG,
+    EXPORT_PPM,
+    EXPORT_RAW,  // The image rows as captured, e.g. BGRA on most visuals
+} ExportFormat;
+
+bool parse_export_format(const char* name, ExportFormat* format);
+ExportFormat export_format_for_path(const char* path);
+bool export_image(const XImage* image, int x, int y, int width, int height,
+                  ExportFormat format, FILE* out);
+bool export_image_to_path(const XImage* image, int x, int y, int width, int height,
+                          ExportFormat format, const char* path);
+void default_export_path(char* path, size_t size);
@@ -0,0 +1,97 @@
+#include "flashlight.h"
+#include "camera.h"
+#include "config.h"
+#include <math.h>
+
+void update_flashlight(Flashlight* fl, float dt, Vec2f cursor_pos) {
+    fl->target_pos = cursor_pos;
+    
+    // Handle manual radius adjustment
+    if (fl->is_enabled && !fl->animating && fabsf(fl->delta_radius) > 1.0f) {
+        fl->target_radius = fmaxf(50.0f, fl->target_radius + fl->delta_radius * dt);
+        fl->delta_radius -= fl->delta_radius * FL_DELTA_RADIUS_DECELERATION * dt;
+    }
+    
+    // Physics-based position update
+    if (fl->is_enabled) {
+        // Calculate spring force: F = -k * (x - target)
+        Vec2f displacement = vec2_sub(fl->position, fl->target_pos);
+        Vec2f spring_force = vec2_mul(displacement, -fl->spring_k);
+        
+        // Calculate damping force: F = -c * v
+        Vec2f damping_force = vec2_mul(fl->velocity, -fl->damping);
+        
+        // Total force
+        Vec2f total_force = vec2_add(spring_force, damping_force);
+        
+        // Acceleration: a = F / m
+        fl->acceleration = vec2_mul(total_force, 1.0f / fl->mass);
+        
+        // Update velocity: v = v + a * dt
+        fl->velocity = vec2_add(fl->velocity, vec2_mul(fl->acceleration, dt));
+        
+        // Update position: p = p + v * dt
+        fl->position = vec2_add(fl->position, vec2_mul(fl->velocity, dt));
+        
+        // Calculate deformation based on velocity and acceleration
+        float vel_mag = vec2_length(fl->velocity);
+        
+        if (vel_mag > 0.1f) {
+            // Normalize velocity to get direction
+            Vec2f vel_norm = vec2_mul(fl->velocity, 1.0f / vel_mag);
+            
+            // Stretch in direction of movement
+            float stretch_amount = vel_mag * config.bubble_stretch_factor;
+            Vec2f target_stretch = vec2_mul(vel_norm, stretch_amount);
+            
+            // Smooth interpolation towards target stretch
+            fl->stretch.x += (target_stretch.x - fl->stretch.x) * config.bubble_deform_smoothing * dt;
+            fl->stretch.y += (target_stretch.y - fl->stretch.y) * config.bubble_deform_smoothing * dt;
+            
+            // Squeeze perpendicular to movement (volume conservation)
+            float target_squeeze = stretch_amount * config.bubble_squeeze_factor;
+            fl->squeeze += (target_squeeze - fl->squeeze) * config.bubble_deform_smoothing * dt;
+        } else {
+            // Recover to circular shape when not moving
+            fl->stretch.x += (0.0f - fl->stretch.x) * config.bubble_deform_smoothing * dt;
+            fl->stretch.y += (0.0f - fl->stretch.y) * config.bubble_deform_smoothing * dt;
+            fl->squeeze += (0.0f - fl->squeeze) * config.bubble_deform_smoothing * dt;
+        }
+    } else {
+        // When disabled, snap to cursor position
+        fl->position = cursor_pos;
+        fl->velocity = (Vec2f){0, 0};
+        fl->acceleration = (Vec2f){0, 0};
+        fl->stretch = (Vec2f){0, 0};
+        fl->squeeze = 0.0f;
+    }
+    
+    // Lerp radius towards target
+    fl->radius += (fl->target_radius - fl->radius) * config.flashlight_lerp_speed * dt;
+    
+    // Stop animating when close enough
+    if (fl->animating && fabsf(fl->target_radius - fl->radius) < 1.0f) {
+        fl->radius = fl->target_radius;
+        fl->animating = false;
+    }
+    
+    // Update shadow
+    float target_shadow = fl->is_enabled ? 0.8f : 0.0f;
+    fl->shadow += (target_shadow - fl->shadow) * config.flashlight_lerp_speed * dt;
+}
+
+// True when update_flashlight() has nothing left to animate
+bool flashlight_is_idle(const Flashlight* fl) {
+    if (fl->animating || fabsf(fl->target_radius - fl->radius) > SETTLE_THRESHOLD) return false;
+    if (fl->is_enabled && fabsf(fl->delta_radius) > 1.0f) return false;
+
+    float target_shadow = fl->is_enabled ? 0.8f : 0.0f;
+    if (fabsf(target_shadow - fl->shadow) > 0.001f) return false;
+
+    if (fl->is_enabled) {
+        if (vec2_length(vec2_sub(fl->position, fl->target_pos)) > SETTLE_THRESHOLD) return false;
+        if (vec2_length(fl->velocity) > 0.1f) return false;
+        if (vec2_length(fl->stretch) > 0.001f || fabsf(fl->squeeze) > 0.001f) return false;
+    }
+    return true;
+}
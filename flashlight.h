@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include "la.h"
+
+#define INITIAL_FL_DELTA_RADIUS 250.0f
+#define FL_DELTA_RADIUS_DECELERATION 10.0f
+
+typedef struct {
+    bool is_enabled;
+    float shadow;
+    float radius;
+    float delta_radius;
+    float target_radius;
+    bool animating;
+    
+    // Physics properties for bubble
+    Vec2f position;      // Current position
+    Vec2f velocity;      // Current velocity
+    Vec2f target_pos;    // Target position (cursor)
+    Vec2f acceleration;  // Current acceleration (for deformation)
+    float mass;          // Mass of the bubble
+    float spring_k;      // Spring constant
+    float damping;       // Damping coefficient
+    
+    // Deformation properties
+    Vec2f stretch;       // Stretch amount in x,y directions
+    float squeeze;       // Perpendicular squeeze factor
+} Flashlight;
+
+void update_flashlight(Flashlight* fl, float dt, Vec2f cursor_pos);
+bool flashlight_is_idle(const Flashlight* fl);
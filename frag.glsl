@@ -1,16 +1,18 @@
 #version 130
 out mediump vec4 color;
 in mediump vec2 texcoord;
+in vec2 screenUV;
 uniform sampler2D tex;
+uniform sampler2D blurTex;
+uniform sampler1D lensProfile;
 uniform vec2 cursorPos;
 uniform vec2 windowSize;
 uniform float flShadow;
 uniform float flRadius;
-uniform float flEnabled;
 uniform float cameraScale;
 uniform vec2 screenshotSize;
-uniform float blur_outside_flashlight;
-uniform float outside_flashlight_blur_radius;
+uniform vec2 tileScale;
+uniform vec4 tileBounds;
 
 uniform vec2 bubbleStretch;
 uniform float bubbleSqueeze;
@@ -41,65 +43,31 @@ float sdfEllipse(vec2 center, float radius, vec2 stretch, float squeeze, vec2 p)
     return k * min(radiusAlong, radiusPerp) - min(radiusAlong, radiusPerp);
 }
 
-vec3 getNormal(float sd, float thickness, float scale) {
-    float dx = dFdx(sd) / scale;
-    float dy = dFdy(sd) / scale;
-    float n_cos = max(thickness + sd, 0.0) / thickness;
-    float n_sin = sqrt(max(0.0, 1.0 - n_cos * n_cos));
-    return normalize(vec3(dx * n_cos, dy * n_cos, n_sin));
-}
-
-float height(float sd, float thickness) {
-    if (sd >= 0.0) return 0.0;
-    if (sd < -thickness) return thickness;
-    float x = thickness + sd;
-    return sqrt(thickness * thickness - x * x);
-}
-
-vec4 gaussianBlur(sampler2D image, vec2 uv, float radius) {
-    if (radius < 0.5) {
-        return texture(image, uv);
-    }
-    vec4 color_sum = vec4(0.0);
-    float total_weight = 0.0;
-    vec2 texelSize = 1.0 / windowSize;
-    int samples = int(clamp(radius * 0.5, 1.0, 8.0));
-    float sigma = radius * 0.3;
-    for (int x = -samples; x <= samples; x++) {
-        for (int y = -samples; y <= samples; y++) {
-            vec2 offset = vec2(float(x), float(y)) * texelSize;
-            float dist_sq = float(x*x + y*y);
-            float weight = exp(-dist_sq / (2.0 * sigma * sigma));
-            color_sum += texture(image, uv + offset) * weight;
-            total_weight += weight;
-        }
-    }
-    return color_sum / total_weight;
-}
-
+// Built in variants: SHADOW darkens around the flashlight, LENS adds the
+// glass, BLUR_OUTSIDE samples the blur around it. Without SHADOW the
+// screenshot is drawn as is. BACKGROUND is the pass for everything outside
+// the lens, the lens itself is drawn over it in a second, scissored pass.
 void main() {
+#if !defined(SHADOW)
+    color = texture(tex, texcoord);
+#elif defined(BACKGROUND)
+#ifdef BLUR_OUTSIDE
+    color = mix(texture(blurTex, screenUV), vec4(0.0, 0.0, 0.0, 0.0), flShadow);
+#else
+    color = mix(texture(tex, texcoord), vec4(0.0, 0.0, 0.0, 0.0), flShadow);
+#endif
+#else
     vec4 cursor = vec4(cursorPos.x, windowSize.y - cursorPos.y, 0.0, 1.0);
     vec2 fragCoord = gl_FragCoord.xy;
     float scaledRadius = flRadius * cameraScale;
     
     float sd = sdfEllipse(cursor.xy, scaledRadius, bubbleStretch, bubbleSqueeze, fragCoord);
     
-    if (flShadow < 0.01) {
-        color = texture(tex, texcoord);
-        return;
-    }
-    
-    float thicknessExponent = 0.5;
-    float thickness = 12.0 * pow(cameraScale, thicknessExponent);
-    float refractiveIndex = 1.45;
-    float baseHeight = thickness * 6.0;
-    
-    vec4 outsideTexture;
-    if (blur_outside_flashlight > 0.5 && flEnabled > 0.5) {
-        outsideTexture = gaussianBlur(tex, texcoord, outside_flashlight_blur_radius);
-    } else {
-        outsideTexture = texture(tex, texcoord);
-    }
+#ifdef BLUR_OUTSIDE
+    vec4 outsideTexture = texture(blurTex, screenUV);
+#else
+    vec4 outsideTexture = texture(tex, texcoord);
+#endif
     
     float bgAlpha = smoothstep(-2.0, 0.0, sd);
     vec4 bgColor = mix(outsideTexture, vec4(0.0, 0.0, 0.0, 0.0), min(bgAlpha, flShadow));
@@ -109,30 +77,40 @@ void main() {
         return;
     }
     
-    if (flEnabled < 0.5) {
-        color = mix(texture(tex, texcoord), bgColor, bgAlpha);
-        return;
-    }
-    
-    vec3 normal = getNormal(sd, thickness, cameraScale);
-    vec3 incident = vec3(0.0, 0.0, -1.0);
-    vec3 refractVec = refract(incident, normal, 1.0 / refractiveIndex);
-    float h = height(sd, thickness);
-    float refractLength = (h + baseHeight) / max(0.001, dot(vec3(0.0, 0.0, -1.0), refractVec));
-    vec2 refractOffset = refractVec.xy * refractLength;
+#ifndef LENS
+    color = mix(texture(tex, texcoord), bgColor, bgAlpha);
+#else
+    float thickness = 12.0 * sqrt(cameraScale);
+    
+    // The rim's normal leans along the SDF gradient and stands up towards the
+    // middle, how far it stands picks the glass profile entry
+    vec2 gradient = vec2(dFdx(sd), dFdy(sd));
+    float slope = length(gradient);
+    vec2 direction = slope > 0.0 ? gradient / slope : vec2(0.0);
+    float nCos = max(thickness + sd, 0.0) / thickness;
+    float nSin = sqrt(max(0.0, 1.0 - nCos * nCos));
+    float elevation = nSin / max(nSin + slope / cameraScale * nCos, 1e-6);
+    float profileSize = float(textureSize(lensProfile, 0));
+    vec3 lens = texture(lensProfile, (elevation * (profileSize - 1.0) + 0.5) / profileSize).rgb;
+    
+    // Glass height is the rim's quarter circle on top of a base six rims deep
+    vec2 refractOffset = direction * lens.r * thickness * (nSin + 6.0);
     vec2 texelSize = 1.0 / windowSize;
-    vec2 refractedUV = texcoord + refractOffset * texelSize;
+    // The offset is in screenshot space, stay inside the pixels this tile holds
+    vec2 refractedUV = clamp(texcoord + refractOffset * texelSize * tileScale,
+                             tileBounds.xy, tileBounds.zw);
     
     vec4 refractColor = texture(tex, refractedUV);
     
-    vec3 reflectVec = reflect(incident, normal);
-    float c = clamp(abs(reflectVec.x - reflectVec.y), 0.0, 1.0);
+    float c = clamp(lens.g * abs(direction.x - direction.y), 0.0, 1.0);
     vec4 reflectColor = vec4(c, c, c, 0.0);
-    float reflectionFactor = (1.0 - normal.z) * 0.2 * (thickness / 12.0);
+    float reflectionFactor = lens.b * 0.2 * (thickness / 12.0);
     vec4 glassColor = mix(refractColor, reflectColor, reflectionFactor);
     glassColor = clamp(glassColor, 0.0, 1.0);
     bgColor = clamp(bgColor, 0.0, 1.0);
     color = mix(glassColor, bgColor, bgAlpha);
+#endif
+#endif
 }
 
 
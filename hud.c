@@ -0,0 +1,181 @@
+#include "hud.h"
+#include "pacer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HUD_SCALE 2.0f
+#define HUD_MARGIN 10.0f
+#define HUD_LINE_HEIGHT ((OVERLAY_GLYPH_HEIGHT + 3) * HUD_SCALE)
+#define HUD_GRAPH_HEIGHT 60.0f
+#define HUD_GRAPH_MAX_MS 33.3f
+#define HUD_BAR_WIDTH 1.5f
+
+static const char* phase_names[HUD_PHASE_COUNT] = {
+    [HUD_PHASE_EVENTS] = "EVENTS",
+    [HUD_PHASE_WINDOW] = "WINDOW",
+    [HUD_PHASE_UPDATE] = "UPDATE",
+    [HUD_PHASE_DRAW]   = "DRAW",
+    [HUD_PHASE_SWAP]   = "SWAP",
+};
+
+void create_hud(Hud* hud) {
+    memset(hud, 0, sizeof(*hud));
+    create_overlay(&hud->overlay);
+    glGenQueries(HUD_QUERY_RING, hud->queries);
+}
+
+void destroy_hud(Hud* hud) {
+    glDeleteQueries(HUD_QUERY_RING, hud->queries);
+    destroy_overlay(&hud->overlay);
+}
+
+void toggle_hud(Hud* hud) {
+    hud->visible = !hud->visible;
+    // History recorded before hiding would show up as a stale spike
+    hud->frame_count = 0;
+    hud->frame_index = 0;
+    hud->phase_start = monotonic_seconds();
+}
+
+void hud_begin_phase(Hud* hud) {
+    if (!hud->visible) return;
+    hud->phase_start = monotonic_seconds();
+}
+
+// Close the phase opened by the last hud_begin_phase() and start the next one
+void hud_end_phase(Hud* hud, HudPhase phase) {
+    if (!hud->visible) return;
+    double now = monotonic_seconds();
+    hud->phase_ms[phase] = (float)((now - hud->phase_start) * 1000.0);
+    hud->phase_start = now;
+}
+
+// Collect finished timer queries without ever waiting for the GPU
+static void collect_queries(Hud* hud) {
+    for (int i = 0; i < HUD_QUERY_RING; i++) {
+        if (!hud->query_pending[i]) continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(hud->queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(hud->queries[i], GL_QUERY_RESULT, &ns);
+            hud->gpu_ms = (float)(ns / 1e6);
+            hud->query_pending[i] = false;
+        }
+    }
+}
+
+void hud_begin_gpu(Hud* hud) {
+    hud->query_active = false;
+    if (!hud->visible) return;
+
+    collect_queries(hud);
+
+    // All slots in flight, skip measuring this frame rather than stall
+    int slot = hud->query_index;
+    if (hud->query_pending[slot]) return;
+
+    glBeginQuery(GL_TIME_ELAPSED, hud->queries[slot]);
+    hud->query_active = true;
+}
+
+void hud_end_gpu(Hud* hud) {
+    if (!hud->query_active) return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    hud->query_pending[hud->query_index] = true;
+    hud->query_index = (hud->query_index + 1) % HUD_QUERY_RING;
+    hud->query_active = false;
+}
+
+// `frame_time` is the measured interval, not the dt clamped for the simulation
+void hud_end_frame(Hud* hud, float frame_time) {
+    if (!hud->visible) return;
+
+    hud->frame_ms[hud->frame_index] = frame_time * 1000.0f;
+    hud->frame_index = (hud->frame_index + 1) % HUD_HISTORY;
+    if (hud->frame_count < HUD_HISTORY) hud->frame_count++;
+}
+
+static int compare_floats(const void* a, const void* b) {
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+static float percentile(const float* sorted, int count, float p) {
+    if (count == 0) return 0.0f;
+    int index = (int)(p * (count - 1) + 0.5f);
+    return sorted[index];
+}
+
+void draw_hud(Hud* hud, Vec2f window_size, size_t texture_bytes, unsigned long round_trips) {
+    if (!hud->visible) return;
+
+    float sorted[HUD_HISTORY];
+    memcpy(sorted, hud->frame_ms, hud->frame_count * sizeof(float));
+    qsort(sorted, hud->frame_count, sizeof(float), compare_floats);
+    float p50 = percentile(sorted, hud->frame_count, 0.50f);
+    float p99 = percentile(sorted, hud->frame_count, 0.99f);
+    int last = (hud->frame_index + HUD_HISTORY - 1) % HUD_HISTORY;
+    float current = hud->frame_count > 0 ? hud->frame_ms[last] : 0.0f;
+
+    Rgba text = {1.0f, 1.0f, 1.0f, 1.0f};
+    Rgba dim = {0.7f, 0.7f, 0.7f, 1.0f};
+    Overlay* o = &hud->overlay;
+
+    float width = HUD_HISTORY * HUD_BAR_WIDTH;
+    float height = HUD_LINE_HEIGHT * (5 + HUD_PHASE_COUNT) + HUD_GRAPH_HEIGHT + HUD_MARGIN;
+    overlay_rect(o, HUD_MARGIN, HUD_MARGIN, width + 2 * HUD_MARGIN, height + HUD_MARGIN,
+                 (Rgba){0.0f, 0.0f, 0.0f, 0.7f});
+
+    float x = 2 * HUD_MARGIN;
+    float y = 2 * HUD_MARGIN;
+    char line[128];
+
+    snprintf(line, sizeof(line), "FRAME %.2f MS (%.0f FPS)", current,
+             current > 0.0f ? 1000.0f / current : 0.0f);
+    overlay_text(o, x, y, HUD_SCALE, text, line);
+    y += HUD_LINE_HEIGHT;
+
+    snprintf(line, sizeof(line), "P50 %.2f MS  P99 %.2f MS", p50, p99);
+    overlay_text(o, x, y, HUD_SCALE, text, line);
+    y += HUD_LINE_HEIGHT;
+
+    snprintf(line, sizeof(line), "GPU DRAW %.2f MS", hud->gpu_ms);
+    overlay_text(o, x, y, HUD_SCALE, text, line);
+    y += HUD_LINE_HEIGHT;
+
+    snprintf(line, sizeof(line), "TEXTURES %.1f MB", texture_bytes / (1024.0 * 1024.0));
+    overlay_text(o, x, y, HUD_SCALE, text, line);
+    y += HUD_LINE_HEIGHT;
+
+    // Xlib calls that waited on the server during the last frame, 0 when steady
+    snprintf(line, sizeof(line), "X ROUND TRIPS %lu", round_trips);
+    overlay_text(o, x, y, HUD_SCALE, text, line);
+    y += HUD_LINE_HEIGHT;
+
+    for (int i = 0; i < HUD_PHASE_COUNT; i++) {
+        snprintf(line, sizeof(line), "%-7s %.3f MS", phase_names[i], hud->phase_ms[i]);
+        overlay_text(o, x, y, HUD_SCALE, dim, line);
+        y += HUD_LINE_HEIGHT;
+    }
+
+    // Frame time graph, oldest sample on the left, with a 60 Hz budget line
+    y += HUD_MARGIN * 0.5f;
+    float bottom = y + HUD_GRAPH_HEIGHT;
+    float budget = bottom - HUD_GRAPH_HEIGHT * (16.7f / HUD_GRAPH_MAX_MS);
+    overlay_rect(o, x, budget, width, 1.0f, (Rgba){1.0f, 1.0f, 0.0f, 0.6f});
+
+    int first = (hud->frame_index + HUD_HISTORY - hud->frame_count) % HUD_HISTORY;
+    for (int i = 0; i < hud->frame_count; i++) {
+        float ms = hud->frame_ms[(first + i) % HUD_HISTORY];
+        float h = HUD_GRAPH_HEIGHT * fminf(ms / HUD_GRAPH_MAX_MS, 1.0f);
+        Rgba bar = ms > 16.7f ? (Rgba){1.0f, 0.3f, 0.3f, 0.9f} : (Rgba){0.3f, 1.0f, 0.4f, 0.9f};
+        overlay_rect(o, x + i * HUD_BAR_WIDTH, bottom - h, HUD_BAR_WIDTH, h, bar);
+    }
+
+    flush_overlay(o, window_size);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <GL/glew.h>
+#include "la.h"
+#include "overlay.h"
+
+#define HUD_HISTORY 240
+#define HUD_QUERY_RING 4
+
+typedef enum {
+    HUD_PHASE_EVENTS,
+    HUD_PHASE_WINDOW,
+    HUD_PHASE_UPDATE,
+    HUD_PHASE_DRAW,
+    HUD_PHASE_SWAP,
+    HUD_PHASE_COUNT
+} HudPhase;
+
+// Performance overlay. Every entry point returns immediately while hidden,
+// so no clocks are read and no queries are issued unless it is on screen.
+typedef struct {
+    bool visible;
+
+    double phase_start;
+    float phase_ms[HUD_PHASE_COUNT];
+
+    float frame_ms[HUD_HISTORY];
+    int frame_index;
+    int frame_count;
+
+    GLuint queries[HUD_QUERY_RING];
+    bool query_pending[HUD_QUERY_RING];
+    int query_index;
+    bool query_active;
+    float gpu_ms;
+
+    Overlay overlay;
+} Hud;
+
+void create_hud(Hud* hud);
+void destroy_hud(Hud* hud);
+void toggle_hud(Hud* hud);
+void hud_begin_phase(Hud* hud);
+void hud_end_phase(Hud* hud, HudPhase phase);
+void hud_begin_gpu(Hud* hud);
+void hud_end_gpu(Hud* hud);
+void hud_end_frame(Hud* hud, float frame_time);
+void draw_hud(Hud* hud, Vec2f window_size, size_t texture_bytes, unsigned long round_trips);
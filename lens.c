@@ -0,0 +1,55 @@
+#include "lens.h"
+#include <math.h>
+
+#define REFRACTIVE_INDEX 1.45f
+
+// One entry, the refract() and reflect() the shader used to run per pixel
+// for a ray looking straight down. `elevation` is n_sin / (n_sin + lean),
+// where the normal is (lean along the gradient, n_sin up) before normalizing.
+static void profile_entry(float elevation, float out[3]) {
+    float nz = 1.0f;
+    float nxy = 0.0f;
+    if (elevation < 1.0f) {
+        float ratio = elevation / (1.0f - elevation);
+        float length = sqrtf(1.0f + ratio * ratio);
+        nz = ratio / length;
+        nxy = 1.0f / length;
+    }
+
+    float eta = 1.0f / REFRACTIVE_INDEX;
+    float k = 1.0f - eta * eta * (1.0f - nz * nz);
+    float refraction = 0.0f;
+    if (k >= 0.0f) {
+        float along_normal = sqrtf(k) - eta * nz;
+        float tz = -eta - along_normal * nz;
+        refraction = -along_normal * nxy / fmaxf(0.001f, -tz);
+    }
+
+    out[0] = refraction;       // Times the glass height, along the gradient
+    out[1] = 2.0f * nz * nxy;  // reflect().xy along the gradient
+    out[2] = 1.0f - nz;
+}
+
+void create_lens_profile(LensProfile* profile) {
+    float table[LENS_PROFILE_SIZE][3];
+    for (int i = 0; i < LENS_PROFILE_SIZE; i++) {
+        profile_entry((float)i / (LENS_PROFILE_SIZE - 1), table[i]);
+    }
+
+    glGenTextures(1, &profile->texture);
+    glBindTexture(GL_TEXTURE_1D, profile->texture);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB32F, LENS_PROFILE_SIZE, 0, GL_RGB, GL_FLOAT, table);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+}
+
+void destroy_lens_profile(LensProfile* profile) {
+    glDeleteTextures(1, &profile->texture);
+    profile->texture = 0;
+}
+
+size_t lens_profile_memory(const LensProfile* profile) {
+    (void)profile;
+    return (size_t)LENS_PROFILE_SIZE * 3 * sizeof(float);
+}
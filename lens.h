@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stddef.h>
+#include <GL/glew.h>
+
+#define LENS_PROFILE_SIZE 256
+
+// The glass the flashlight refracts through, tabulated against how far the
+// rim's normal stands up from lying flat (0) to pointing at the viewer (1):
+// refraction per unit of glass height, reflection strength and reflection
+// mix. Radius and scale only move pixels along that axis, so the table is
+// built once and the fragment shader does a single lookup.
+typedef struct {
+    GLuint texture;
+} LensProfile;
+
+void create_lens_profile(LensProfile* profile);
+void destroy_lens_profile(LensProfile* profile);
+size_t lens_profile_memory(const LensProfile* profile);
@@ -5,8 +5,13 @@
 #include <string.h>
 #include <math.h>
 #include <stdbool.h>
+#include <errno.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
 #include <GL/glew.h>
 #include <GL/gl.h>
 #include <GL/glx.h>
@@ -19,463 +24,390 @@
 #include "config.h"
 #include "screenshot.h"
 #include "camera.h"
+#include "flashlight.h"
+#include "shader.h"
+#include "render.h"
+#include "pacer.h"
+#include "hud.h"
+#include "bench.h"
+#include "monitor.h"
+#include "daemon.h"
+#include "colorstats.h"
+#include "export.h"
+#include "clipboard.h"
+#include "overlay.h"
+#include "recorder.h"
+#include "pointer.h"
+#include "roundtrip.h"
 #include "la.h"
 
-#define MAX_SHADER_SIZE 16384
-
-typedef struct {
-    char path[256];
-    char content[MAX_SHADER_SIZE];
-} Shader;
-
-typedef struct {
-    bool is_enabled;
-    float shadow;
-    float radius;
-    float delta_radius;
-    float target_radius;
-    bool animating;
-    
-    // Physics properties for bubble
-    Vec2f position;      // Current position
-    Vec2f velocity;      // Current velocity
-    Vec2f target_pos;    // Target position (cursor)
-    Vec2f acceleration;  // Current acceleration (for deformation)
-    float mass;          // Mass of the bubble
-    float spring_k;      // Spring constant
-    float damping;       // Damping coefficient
-    
-    // Deformation properties
-    Vec2f stretch;       // Stretch amount in x,y directions
-    float squeeze;       // Perpendicular squeeze factor
-} Flashlight;
+#define STATS_PANEL_SCALE 2.0f
+#define STATS_PANEL_MARGIN 10.0f
+#define STATS_HISTOGRAM_HEIGHT 32.0f
+// Frames to retry the keyboard grab for while another client holds it
+#define KEYBOARD_GRAB_ATTEMPTS 30
 
 typedef struct {
     bool is_enabled;
     unsigned char r, g, b;  // Current color under cursor
+
+    // Rectangle dragged with the right button, in screenshot pixels
+    bool selecting;
+    bool has_selection;
+    int x0, y0, x1, y1;
+    int computed[4];  // Rectangle the stats below were computed for
+    ColorStats stats;
 } ColorPicker;
 
-#define INITIAL_FL_DELTA_RADIUS 250.0f
-#define FL_DELTA_RADIUS_DECELERATION 10.0f
+// Transform a window position to screenshot coordinates
+static Vec2f screenshot_point(const Camera* camera, Vec2f cursor_pos, Vec2f window_size) {
+    Vec2f half_window = vec2_mul(window_size, 0.5f);
+    Vec2f centered_cursor = vec2_sub(cursor_pos, half_window);
+    Vec2f world_pos = vec2_div(centered_cursor, camera->scale);
+    return vec2_add(world_pos, camera->position);
+}
+
+static Vec2f window_point(const Camera* camera, Vec2f screenshot_pos, Vec2f window_size) {
+    Vec2f relative = vec2_sub(screenshot_pos, camera->position);
+    return vec2_add(vec2_mul(relative, camera->scale), vec2_mul(window_size, 0.5f));
+}
 
-static char* read_file(const char* path) {
-    FILE* f = fopen(path, "r");
-    if (!f) return NULL;
+static void update_color_picker(ColorPicker* picker, Screenshot* screenshot, Camera* camera, Vec2f cursor_pos, Vec2f window_size) {
+    if (!picker->is_enabled) return;
     
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    Vec2f screenshot_pos = screenshot_point(camera, cursor_pos, window_size);
+    int x = (int)screenshot_pos.x;
+    int y = (int)screenshot_pos.y;
     
-    char* content = malloc(size + 1);
-    fread(content, 1, size, f);
-    content[size] = '\0';
-    fclose(f);
+    // Clamp to screenshot bounds
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x >= screenshot->image->width) x = screenshot->image->width - 1;
+    if (y >= screenshot->image->height) y = screenshot->image->height - 1;
     
-    return content;
-}
+    Rgb8 color = image_color_at(screenshot->image, x, y);
+    picker->r = color.r;
+    picker->g = color.g;
+    picker->b = color.b;
 
-static bool load_shader(Shader* shader, const char* config_path, const char* fallback_path) {
-    if (config_path && config_path[0] != '\0') {
-        char* content = read_file(config_path);
-        if (content) {
-            strncpy(shader->path, config_path, sizeof(shader->path) - 1);
-            strncpy(shader->content, content, sizeof(shader->content) - 1);
-            free(content);
-            return true;
-        } else {
-            fprintf(stderr, "Warning: Could not load shader from config path: %s\n", config_path);
-        }
+    if (picker->selecting) {
+        picker->x1 = x;
+        picker->y1 = y;
     }
-    
-    char* content = read_file(fallback_path);
-    if (!content) {
-        fprintf(stderr, "Error: Could not load shader from fallback path: %s\n", fallback_path);
-        return false;
+
+    // Only recount when the rectangle changed, a still selection costs nothing
+    if (picker->has_selection) {
+        int rect[4] = {
+            picker->x0 < picker->x1 ? picker->x0 : picker->x1,
+            picker->y0 < picker->y1 ? picker->y0 : picker->y1,
+            abs(picker->x1 - picker->x0) + 1,
+            abs(picker->y1 - picker->y0) + 1,
+        };
+        if (memcmp(rect, picker->computed, sizeof(rect)) != 0) {
+            compute_color_stats(screenshot->image, rect[0], rect[1], rect[2], rect[3], &picker->stats);
+            memcpy(picker->computed, rect, sizeof(rect));
+        }
     }
-    
-    strncpy(shader->path, fallback_path, sizeof(shader->path) - 1);
-    strncpy(shader->content, content, sizeof(shader->content) - 1);
-    free(content);
-    return true;
 }
 
-static GLuint compile_shader(const Shader* shader, GLenum type) {
-    GLuint id = glCreateShader(type);
-    const char* src = shader->content;
-    glShaderSource(id, 1, &src, NULL);
-    glCompileShader(id);
-    
-    GLint success;
-    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char log[512];
-        glGetShaderInfoLog(id, sizeof(log), NULL, log);
-        fprintf(stderr, "Shader compilation error (%s):\n%s\n", shader->path, log);
-    }
-    
-    return id;
+static void stats_line(Overlay* overlay, float x, float y, const char* label, Rgb8 color) {
+    float size = OVERLAY_GLYPH_HEIGHT * STATS_PANEL_SCALE;
+    overlay_rect(overlay, x, y, size, size, (Rgba){color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, 1.0f});
+
+    char line[64];
+    snprintf(line, sizeof(line), "%-4s #%02X%02X%02X", label, color.r, color.g, color.b);
+    overlay_text(overlay, x + size + STATS_PANEL_SCALE * 4, y, STATS_PANEL_SCALE,
+                 (Rgba){1.0f, 1.0f, 1.0f, 1.0f}, line);
 }
 
-static GLuint create_shader_program(const Shader* vertex, const Shader* fragment) {
-    GLuint vs = compile_shader(vertex, GL_VERTEX_SHADER);
-    GLuint fs = compile_shader(fragment, GL_FRAGMENT_SHADER);
-    
-    GLuint program = glCreateProgram();
-    glAttachShader(program, vs);
-    glAttachShader(program, fs);
-    glLinkProgram(program);
-    
-    GLint success;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        char log[512];
-        glGetProgramInfoLog(program, sizeof(log), NULL, log);
-        fprintf(stderr, "Shader linking error:\n%s\n", log);
+// Outline the selection and show its statistics in the top right corner
+static void draw_color_stats(Overlay* overlay, const ColorPicker* picker, const Camera* camera, Vec2f window_size) {
+    const int* r = picker->computed;
+    Vec2f a = window_point(camera, (Vec2f){(float)r[0], (float)r[1]}, window_size);
+    Vec2f b = window_point(camera, (Vec2f){(float)(r[0] + r[2]), (float)(r[1] + r[3])}, window_size);
+    Rgba outline = {1.0f, 1.0f, 1.0f, 0.9f};
+    overlay_rect(overlay, a.x, a.y, b.x - a.x, 1.0f, outline);
+    overlay_rect(overlay, a.x, b.y - 1.0f, b.x - a.x, 1.0f, outline);
+    overlay_rect(overlay, a.x, a.y, 1.0f, b.y - a.y, outline);
+    overlay_rect(overlay, b.x - 1.0f, a.y, 1.0f, b.y - a.y, outline);
+
+    const ColorStats* stats = &picker->stats;
+    float line_height = (OVERLAY_GLYPH_HEIGHT + 3) * STATS_PANEL_SCALE;
+    float width = 256.0f;
+    float height = line_height * 6 + (STATS_HISTOGRAM_HEIGHT + STATS_PANEL_MARGIN) * 3;
+    float x = window_size.x - width - 2 * STATS_PANEL_MARGIN;
+    float y = 2 * STATS_PANEL_MARGIN;
+    overlay_rect(overlay, x - STATS_PANEL_MARGIN, y - STATS_PANEL_MARGIN,
+                 width + 2 * STATS_PANEL_MARGIN, height + STATS_PANEL_MARGIN, (Rgba){0.0f, 0.0f, 0.0f, 0.7f});
+
+    char line[64];
+    snprintf(line, sizeof(line), "%dX%d  %llu PX", r[2], r[3], (unsigned long long)stats->count);
+    overlay_text(overlay, x, y, STATS_PANEL_SCALE, (Rgba){0.7f, 0.7f, 0.7f, 1.0f}, line);
+    y += line_height;
+
+    stats_line(overlay, x, y, "AVG", stats->average);  y += line_height;
+    stats_line(overlay, x, y, "MED", stats->median);   y += line_height;
+    stats_line(overlay, x, y, "DOM", stats->dominant); y += line_height;
+    stats_line(overlay, x, y, "MIN", stats->min);      y += line_height;
+    stats_line(overlay, x, y, "MAX", stats->max);      y += line_height;
+
+    static const Rgba channel_colors[3] = {
+        {1.0f, 0.3f, 0.3f, 0.9f},
+        {0.3f, 1.0f, 0.4f, 0.9f},
+        {0.4f, 0.5f, 1.0f, 0.9f},
+    };
+    float peak = stats->histogram_peak > 0 ? (float)stats->histogram_peak : 1.0f;
+    for (int c = 0; c < 3; c++) {
+        y += STATS_PANEL_MARGIN;
+        float bottom = y + STATS_HISTOGRAM_HEIGHT;
+        for (int v = 0; v < 256; v++) {
+            float h = STATS_HISTOGRAM_HEIGHT * stats->histogram[c][v] / peak;
+            if (h > 0.0f) {
+                overlay_rect(overlay, x + v, bottom - h, 1.0f, h, channel_colors[c]);
+            }
+        }
+        y = bottom;
     }
-    
-    glDeleteShader(vs);
-    glDeleteShader(fs);
-    glUseProgram(program);
-    
-    return program;
+
+    flush_overlay(overlay, window_size);
 }
 
-static void update_flashlight(Flashlight* fl, float dt, Vec2f cursor_pos) {
-    fl->target_pos = cursor_pos;
-    
-    // Handle manual radius adjustment
-    if (fl->is_enabled && !fl->animating && fabsf(fl->delta_radius) > 1.0f) {
-        fl->target_radius = fmaxf(50.0f, fl->target_radius + fl->delta_radius * dt);
-        fl->delta_radius -= fl->delta_radius * FL_DELTA_RADIUS_DECELERATION * dt;
+// Part of the screenshot currently on screen as x, y, width, height
+static void visible_region(const Camera* camera, Vec2f window_size, int region[4]) {
+    Vec2f top_left = screenshot_point(camera, (Vec2f){0.0f, 0.0f}, window_size);
+    Vec2f bottom_right = screenshot_point(camera, window_size, window_size);
+    region[0] = (int)floorf(top_left.x);
+    region[1] = (int)floorf(top_left.y);
+    region[2] = (int)ceilf(bottom_right.x) - region[0];
+    region[3] = (int)ceilf(bottom_right.y) - region[1];
+}
+
+// Save the part of the screenshot currently on screen to screenshot_directory
+static void save_visible_region(const Screenshot* screenshot, const Camera* camera, Vec2f window_size) {
+    int region[4];
+    visible_region(camera, window_size, region);
+
+    char path[1024];
+    default_export_path(path, sizeof(path));
+    if (export_image_to_path(screenshot->image, region[0], region[1], region[2], region[3], EXPORT_PNG, path)) {
+        fprintf(stderr, "Saved screenshot to %s\n", path);
     }
-    
-    // Physics-based position update
-    if (fl->is_enabled) {
-        // Calculate spring force: F = -k * (x - target)
-        Vec2f displacement = vec2_sub(fl->position, fl->target_pos);
-        Vec2f spring_force = vec2_mul(displacement, -fl->spring_k);
-        
-        // Calculate damping force: F = -c * v
-        Vec2f damping_force = vec2_mul(fl->velocity, -fl->damping);
-        
-        // Total force
-        Vec2f total_force = vec2_add(spring_force, damping_force);
-        
-        // Acceleration: a = F / m
-        fl->acceleration = vec2_mul(total_force, 1.0f / fl->mass);
-        
-        // Update velocity: v = v + a * dt
-        fl->velocity = vec2_add(fl->velocity, vec2_mul(fl->acceleration, dt));
-        
-        // Update position: p = p + v * dt
-        fl->position = vec2_add(fl->position, vec2_mul(fl->velocity, dt));
-        
-        // Calculate deformation based on velocity and acceleration
-        float vel_mag = vec2_length(fl->velocity);
-        
-        if (vel_mag > 0.1f) {
-            // Normalize velocity to get direction
-            Vec2f vel_norm = vec2_mul(fl->velocity, 1.0f / vel_mag);
-            
-            // Stretch in direction of movement
-            float stretch_amount = vel_mag * config.bubble_stretch_factor;
-            Vec2f target_stretch = vec2_mul(vel_norm, stretch_amount);
-            
-            // Smooth interpolation towards target stretch
-            fl->stretch.x += (target_stretch.x - fl->stretch.x) * config.bubble_deform_smoothing * dt;
-            fl->stretch.y += (target_stretch.y - fl->stretch.y) * config.bubble_deform_smoothing * dt;
-            
-            // Squeeze perpendicular to movement (volume conservation)
-            float target_squeeze = stretch_amount * config.bubble_squeeze_factor;
-            fl->squeeze += (target_squeeze - fl->squeeze) * config.bubble_deform_smoothing * dt;
-        } else {
-            // Recover to circular shape when not moving
-            fl->stretch.x += (0.0f - fl->stretch.x) * config.bubble_deform_smoothing * dt;
-            fl->stretch.y += (0.0f - fl->stretch.y) * config.bubble_deform_smoothing * dt;
-            fl->squeeze += (0.0f - fl->squeeze) * config.bubble_deform_smoothing * dt;
-        }
-    } else {
-        // When disabled, snap to cursor position
-        fl->position = cursor_pos;
-        fl->velocity = (Vec2f){0, 0};
-        fl->acceleration = (Vec2f){0, 0};
-        fl->stretch = (Vec2f){0, 0};
-        fl->squeeze = 0.0f;
+}
+
+static void copy_visible_region(const Screenshot* screenshot, const Camera* camera, Vec2f window_size) {
+    int region[4];
+    visible_region(camera, window_size, region);
+    copy_image_to_clipboard(screenshot->image, region[0], region[1], region[2], region[3]);
+}
+
+#ifdef LIVE
+// Whether the next refresh can change the screenshot
+static bool capture_pending(const Screenshot* screenshot) {
+#ifdef DAMAGE
+    if (screenshot->damage) {
+        return screenshot->damaged;
     }
-    
-    // Lerp radius towards target
-    fl->radius += (fl->target_radius - fl->radius) * config.flashlight_lerp_speed * dt;
-    
-    // Stop animating when close enough
-    if (fl->animating && fabsf(fl->target_radius - fl->radius) < 1.0f) {
-        fl->radius = fl->target_radius;
-        fl->animating = false;
+#else
+    (void)screenshot;
+#endif
+    return true;
+}
+#endif
+
+// Initial capture, run on a worker thread while the window, GL context and
+// shaders are set up on the main one
+typedef struct {
+    pthread_t thread;
+    bool threaded;
+    Display* display;
+    Window window;
+    Monitor area;
+    bool use_area;
+    Screenshot screenshot;
+    double finished;
+} CaptureJob;
+
+static void* capture_worker(void* arg) {
+    CaptureJob* job = arg;
+    job->screenshot = job->use_area
+        ? create_screenshot_area(job->display, job->window, job->area.x, job->area.y,
+                                 job->area.width, job->area.height)
+        : create_screenshot(job->display, job->window);
+    job->finished = monotonic_seconds();
+    return NULL;
+}
+
+static void start_capture(CaptureJob* job) {
+    job->threaded = pthread_create(&job->thread, NULL, capture_worker, job) == 0;
+    if (!job->threaded) {
+        // No thread, capture right here instead
+        capture_worker(job);
     }
-    
-    // Update shadow
-    float target_shadow = fl->is_enabled ? 0.8f : 0.0f;
-    fl->shadow += (target_shadow - fl->shadow) * config.flashlight_lerp_speed * dt;
 }
 
-static void update_color_picker(ColorPicker* picker, Screenshot* screenshot, Camera* camera, Vec2f cursor_pos, Vec2f window_size) {
-    if (!picker->is_enabled) return;
-    
-    // Transform cursor position to screenshot coordinates
-    Vec2f half_window = vec2_mul(window_size, 0.5f);
-    Vec2f centered_cursor = vec2_sub(cursor_pos, half_window);
-    Vec2f world_pos = vec2_div(centered_cursor, camera->scale);
-    Vec2f screenshot_pos = vec2_add(world_pos, camera->position);
-    
-    int x = (int)screenshot_pos.x;
-    int y = (int)screenshot_pos.y;
-    
-    // Clamp to screenshot bounds
-    if (x < 0) x = 0;
-    if (y < 0) y = 0;
-    if (x >= screenshot->image->width) x = screenshot->image->width - 1;
-    if (y >= screenshot->image->height) y = screenshot->image->height - 1;
-    
-    // Get pixel color from XImage
-    unsigned long pixel = XGetPixel(screenshot->image, x, y);
-    
-    // Extract RGB components (assuming 32-bit BGRA format)
-    picker->r = (pixel >> 16) & 0xFF;
-    picker->g = (pixel >> 8) & 0xFF;
-    picker->b = pixel & 0xFF;
+static Screenshot finish_capture(CaptureJob* job) {
+    if (job->threaded) {
+        pthread_join(job->thread, NULL);
+    }
+    return job->screenshot;
 }
 
-static void draw_scene(Screenshot* screenshot, Camera* camera, GLuint shader, GLuint vao,
-                      Vec2f window_size, Flashlight* flashlight) {
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
-    glUseProgram(shader);
+// Phase timings printed with -v, from startup or from a daemon activation
+static struct {
+    bool verbose;
+    double start;
+    double last;
+} timing;
 
-    glUniform2f(glGetUniformLocation(shader, "cameraPos"), camera->position.x, camera->position.y);
-    glUniform1f(glGetUniformLocation(shader, "cameraScale"), camera->scale);
-    glUniform2f(glGetUniformLocation(shader, "screenshotSize"),
-                (float)screenshot->image->width, (float)screenshot->image->height);
-    glUniform2f(glGetUniformLocation(shader, "windowSize"), window_size.x, window_size.y);
-    
-    glUniform2f(glGetUniformLocation(shader, "cursorPos"), flashlight->position.x, flashlight->position.y);
+static void begin_timing(bool verbose) {
+    timing.verbose = verbose;
+    timing.start = monotonic_seconds();
+    timing.last = timing.start;
+}
 
-    glUniform2f(glGetUniformLocation(shader, "bubbleStretch"), flashlight->stretch.x, flashlight->stretch.y);
-    glUniform1f(glGetUniformLocation(shader, "bubbleSqueeze"), flashlight->squeeze);
-    
-    glUniform1f(glGetUniformLocation(shader, "flShadow"), flashlight->shadow);
-    glUniform1f(glGetUniformLocation(shader, "flRadius"), flashlight->radius);
-    glUniform1f(glGetUniformLocation(shader, "flEnabled"), flashlight->is_enabled ? 1.0f : 0.0f);
-    glUniform1f(glGetUniformLocation(shader, "blur_background"), config.blur_background ? 1.0f : 0.0f);
-    glUniform1f(glGetUniformLocation(shader, "background_blur_radius"), config.background_blur_radius);
-    glUniform1f(glGetUniformLocation(shader, "blur_outside_flashlight"), config.blur_outside_flashlight ? 1.0f : 0.0f);
-    glUniform1f(glGetUniformLocation(shader, "outside_flashlight_blur_radius"), config.outside_flashlight_blur_radius);
-    
-    glBindVertexArray(vao);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
+// Print how long the phase that just ended took
+static void log_timing(const char* phase) {
+    if (!timing.verbose) return;
+    double now = monotonic_seconds();
+    fprintf(stderr, "timing: %-16s %8.2f ms  (%8.2f ms since start)\n",
+            phase, (now - timing.last) * 1000.0, (now - timing.start) * 1000.0);
+    timing.last = now;
 }
 
-static Vec2f get_cursor_position(Display* display) {
+// Block until the X connection has something to read or a watched shader
+// file changed, `watch_fd` is ignored when negative
+static void wait_for_events(Display* display, int watch_fd) {
+    struct pollfd fds[2] = {
+        {.fd = ConnectionNumber(display), .events = POLLIN},
+        {.fd = watch_fd, .events = POLLIN},
+    };
+    while (poll(fds, watch_fd >= 0 ? 2 : 1, -1) < 0) {
+        // Retry when interrupted by a signal
+    }
+}
+
+// Pointer position relative to `window`
+static Vec2f get_cursor_position(Display* display, Window window) {
     Window root, child;
     int root_x, root_y, win_x, win_y;
     unsigned int mask;
     
-    XQueryPointer(display, DefaultRootWindow(display),
+    XQueryPointer(display, window,
                   &root, &child, &root_x, &root_y, &win_x, &win_y, &mask);
     
-    return (Vec2f){(float)root_x, (float)root_y};
+    return (Vec2f){(float)win_x, (float)win_y};
 }
 
-static void print_usage(void) {
-    printf("Usage: zoomer [OPTIONS]\n");
-    printf("  -d, --delay <seconds>     delay execution by <seconds>\n");
-    printf("  -h, --help                show this help\n");
-    printf("  -c, --config <filepath>   use config at <filepath>\n");
-    printf("  -w, --windowed            windowed mode\n");
-    printf("  -p, --pick                start in color picker mode\n");
-    printf("  --new-config [filepath]   generate default config\n");
+// Move the mouse to the last position the queue reported, dragging the
+// camera along. The whole frame's motion is applied as one step.
+static void apply_pointer_motion(PointerInput* input, Mouse* mouse, Camera* camera, float dt) {
+    if (!input->moved) return;
+    input->moved = false;
+
+    mouse->curr = input->position;
+    if (mouse->drag) {
+        Vec2f delta = vec2_sub(world(camera, mouse->prev), world(camera, mouse->curr));
+        camera->position = vec2_add(camera->position, delta);
+        camera->target_position = camera->position;
+        camera->velocity = vec2_div(delta, dt);
+    }
+    mouse->prev = mouse->curr;
 }
 
-int main(int argc, char** argv) {
-    bool windowed = false;
-    float delay_sec = 0.0f;
-    char config_file[512] = {0};
-    bool start_in_picker_mode = false;
+// Everything that outlives a single zoom: the connection, window, GL context,
+// compiled program and capture buffers. A daemon keeps all of it warm.
+typedef struct {
+    Display* display;
+    Window tracking_window;
+    Window win;
+    GLXContext glc;
+    Atom wm_delete;
+    Cursor crosshair_cursor;
+    ShaderLibrary shaders;
+    bool windowed;
 
+    Monitor monitors[MAX_MONITORS];
+    int monitor_count;
+    int monitor;  // -1 covers the whole tracking window
 
-    const char* home = getenv("HOME");
-    if (home) {
-        snprintf(config_file, sizeof(config_file), "%s/.config/zoomer/config", home);
+    Screenshot screenshot;
+    Renderer renderer;
+    FramePacer pacer;
+    Hud hud;
+    Overlay overlay;
+    Recorder* recorder;  // NULL unless the session is recorded
+    PointerDevices pointer;
+} App;
+
+// Replace the capture and its textures with the given monitor and move the
+// window there. The window still covers the old monitor, so the new one can
+// be captured right away.
+static void switch_monitor(App* app, int index) {
+    app->monitor = index;
+    const Monitor* next = &app->monitors[index];
+
+    Screenshot next_screenshot = create_screenshot_area(
+        app->display, app->tracking_window, next->x, next->y, next->width, next->height);
+    Renderer next_renderer;
+    create_renderer(&next_renderer, &app->shaders, &next_screenshot);
+
+    destroy_renderer(&app->renderer);
+    destroy_screenshot(&app->screenshot, app->display);
+    app->screenshot = next_screenshot;
+    app->renderer = next_renderer;
+
+    XMoveResizeWindow(app->display, app->win, next->x, next->y, next->width, next->height);
+    if (next->rate >= 30.0f && next->rate <= 500.0f) {
+        app->pacer.nominal_dt = 1.0f / next->rate;
     }
-    
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--delay") == 0) {
-            if (i + 1 < argc) {
-                delay_sec = atof(argv[++i]);
-            }
-        } else if (strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "--windowed") == 0) {
-            windowed = true;
-        } else if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--pick") == 0) {
-            start_in_picker_mode = true;
-        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
-            print_usage();
-            return 0;
-        } else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--config") == 0) {
-            if (i + 1 < argc) {
-                strncpy(config_file, argv[++i], sizeof(config_file) - 1);
-            }
-        } else if (strcmp(argv[i], "--new-config") == 0) {
-            const char* path = (i + 1 < argc) ? argv[i + 1] : config_file;
-            generate_default_config(path);
-            printf("Generated config at %s\n", path);
-            return 0;
+}
+
+// Bring the resident capture up to date before showing it again. Only what
+// changed is fetched when XDamage is tracking the screen.
+static void recapture(App* app) {
+    if (app->monitor >= 0) {
+        Vec2f pointer = get_cursor_position(app->display, app->tracking_window);
+        int index = monitor_at(app->monitors, app->monitor_count, (int)pointer.x, (int)pointer.y);
+        if (index != app->monitor) {
+            switch_monitor(app, index);
+            log_timing("switch monitor");
+            return;
         }
     }
-    
-    if (delay_sec > 0.0f) {
-        struct timespec ts;
-        ts.tv_sec = (time_t)delay_sec;
-        ts.tv_nsec = (long)((delay_sec - ts.tv_sec) * 1000000000);
-        nanosleep(&ts, NULL);
-    }
-    
-    config = load_config(config_file);
-    
-    Display* display = XOpenDisplay(NULL);
-    if (!display) {
-        fprintf(stderr, "Failed to open display\n");
-        return 1;
-    }
-    
-    Window tracking_window = DefaultRootWindow(display);
-    
-    XRRScreenConfiguration* screen_config = XRRGetScreenInfo(display, DefaultRootWindow(display));
-    short rate = XRRConfigCurrentRate(screen_config);
-    XRRFreeScreenConfigInfo(screen_config);
-    
-    if (rate < 30 || rate > 500) {
-        rate = 60;
-        printf("Screen rate detection failed, using default: 60 Hz\n");
-    } else {
-        printf("Screen rate: %d Hz\n", rate);
-    }
-    
-    int screen = DefaultScreen(display);
-    
-    GLint glx_attrs[] = {
-        GLX_RGBA,
-        GLX_DEPTH_SIZE, 24,
-        GLX_DOUBLEBUFFER,
-        None
-    };
-    
-    XVisualInfo* vi = glXChooseVisual(display, screen, glx_attrs);
-    if (!vi) {
-        fprintf(stderr, "No appropriate visual found\n");
-        return 1;
-    }
-    
-    XSetWindowAttributes swa = {0};
-    swa.colormap = XCreateColormap(display, DefaultRootWindow(display), vi->visual, AllocNone);
-    swa.event_mask = ButtonPressMask | ButtonReleaseMask | KeyPressMask | KeyReleaseMask |
-        PointerMotionMask | ExposureMask | StructureNotifyMask;
-    if (!windowed) {
-        swa.override_redirect = True;
-        swa.save_under = True;
-    }
-    
-    XWindowAttributes root_attrs;
-    XGetWindowAttributes(display, DefaultRootWindow(display), &root_attrs);
-    
-    Window win = XCreateWindow(display, DefaultRootWindow(display),
-                               0, 0, root_attrs.width, root_attrs.height, 0,
-                               vi->depth, InputOutput, vi->visual,
-                               CWColormap | CWEventMask | CWOverrideRedirect | CWSaveUnder,
-                               &swa);
-    
-    XStoreName(display, win, "zoomer");
-    XMapWindow(display, win);
-    
-    Atom wm_delete = XInternAtom(display, "WM_DELETE_WINDOW", False);
-    XSetWMProtocols(display, win, &wm_delete, 1);
-    
-    GLXContext glc = glXCreateContext(display, vi, NULL, GL_TRUE);
-    glXMakeCurrent(display, win, glc);
-    
-    glewExperimental = GL_TRUE;
-    GLenum glew_err = glewInit();
-    if (glew_err != GLEW_OK) {
-        fprintf(stderr, "GLEW initialization failed: %s\n", glewGetErrorString(glew_err));
-        return 1;
-    }
-    printf("OpenGL version: %s\n", glGetString(GL_VERSION));
-    
-    Shader vertex_shader, fragment_shader;
-    if (!load_shader(&vertex_shader, config.vertex_shader_path, "/etc/zoomer/vert.glsl") || 
-        !load_shader(&fragment_shader, config.fragment_shader_path, "/etc/zoomer/frag.glsl")) {
-        fprintf(stderr, "Failed to load shaders\n");
-        return 1;
-    }
-    
-    printf("Loaded vertex shader:   %s\n", vertex_shader.path);
-    printf("Loaded fragment shader: %s\n", fragment_shader.path);
-    
-    GLuint shader_program = create_shader_program(&vertex_shader, &fragment_shader);
-    
-    Screenshot screenshot = create_screenshot(display, tracking_window);
-    
-    float w = (float)screenshot.image->width;
-    float h = (float)screenshot.image->height;
-    
-    GLfloat vertices[] = {
-        w, 0, 0.0f, 1.0f, 1.0f,
-        w, h, 0.0f, 1.0f, 0.0f,
-        0, h, 0.0f, 0.0f, 0.0f,
-        0, 0, 0.0f, 0.0f, 1.0f
-    };
-    
-    GLuint indices[] = {0, 1, 3, 1, 2, 3};
-    
-    GLuint vao, vbo, ebo;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
-    
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)0);
-    glEnableVertexAttribArray(0);
-    
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-    
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, screenshot.image->width, screenshot.image->height,
-                 0, GL_BGRA, GL_UNSIGNED_BYTE, screenshot.image->data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    
-    glUniform1i(glGetUniformLocation(shader_program, "tex"), 0);
-    glEnable(GL_TEXTURE_2D);
-    
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+    refresh_screenshot(&app->screenshot, app->display, app->tracking_window);
+#ifdef MITSHM
+    log_timing(app->screenshot.use_shm ? "capture (shm)" : "capture");
+#else
+    log_timing("capture");
+#endif
+    update_renderer(&app->renderer, &app->screenshot);
+    log_timing("upload");
+}
+
+// Show the window and zoom until the user quits, picked colors go to `out`.
+// The window is unmapped again on return, everything else stays allocated.
+static void run_session(App* app, bool start_in_picker_mode, FILE* out) {
+    Display* display = app->display;
+    Window win = app->win;
+    Window tracking_window = app->tracking_window;
+    bool windowed = app->windowed;
+    Atom wm_delete = app->wm_delete;
+    Cursor crosshair_cursor = app->crosshair_cursor;
+    (void)tracking_window;
+
+    XMapRaised(display, win);
+    reset_frame_pacer(&app->pacer);
+    reset_pointer_devices(&app->pointer);
 
     Camera camera = {.scale = 1.0f, .target_scale = 1.0f,};
-    Vec2f cursor_pos = get_cursor_position(display);
+    Vec2f cursor_pos = get_cursor_position(display, win);
     Mouse mouse = {.curr = cursor_pos, .prev = cursor_pos};
     
+    // Only asked once, ConfigureNotify keeps it current from here on
     XWindowAttributes initial_wa;
     XGetWindowAttributes(display, win, &initial_wa);
-    float max_screen_dimension = fmaxf(initial_wa.width, initial_wa.height);
+    Vec2f window_size = {(float)initial_wa.width, (float)initial_wa.height};
     
     // Initialize flashlight with physics and deformation properties
     Flashlight flashlight = {
@@ -498,43 +430,60 @@ int main(int argc, char** argv) {
         .is_enabled = start_in_picker_mode,
         .r = 0, .g = 0, .b = 0
     };
-    
-    Cursor crosshair_cursor = XCreateFontCursor(display, XC_crosshair);
 
     // If starting in picker mode, set the cursor immediately
     if (start_in_picker_mode) {
         XDefineCursor(display, win, crosshair_cursor);
     }
-
     
-    float dt = 1.0f / (float)rate;
+    float dt = app->pacer.nominal_dt;
     bool running = true;
+    bool idle = false;
+    bool first_frame = true;
+
+    // A managed window gets its focus from the window manager
+    bool mapped = false;
+    bool keyboard_ready = windowed;
+    int grab_attempts = 0;
+    unsigned long round_trips = round_trip_count();
     
     while (running) {
-        if (!windowed) {
-            XSetInputFocus(display, win, RevertToParent, CurrentTime);
+        hud_begin_phase(&app->hud);
+        unsigned long frame_round_trips = round_trip_count() - round_trips;
+        round_trips += frame_round_trips;
+
+        // The grab waits until the window is viewable. Should another client
+        // keep the keyboard grabbed, fall back to just taking the focus.
+        if (!keyboard_ready && mapped) {
+            keyboard_ready = XGrabKeyboard(display, win, True, GrabModeAsync, GrabModeAsync,
+                                           CurrentTime) == GrabSuccess;
+            if (!keyboard_ready && ++grab_attempts >= KEYBOARD_GRAB_ATTEMPTS) {
+                fprintf(stderr, "Could not grab the keyboard, keys may go to other windows\n");
+                XSetInputFocus(display, win, RevertToParent, CurrentTime);
+                keyboard_ready = true;
+            }
         }
         
-        XWindowAttributes wa;
-        XGetWindowAttributes(display, win, &wa);
-        glViewport(0, 0, wa.width, wa.height);
+        glViewport(0, 0, (int)window_size.x, (int)window_size.y);
+        hud_end_phase(&app->hud, HUD_PHASE_WINDOW);
+
+        // Nothing moved last frame, sleep until input arrives instead of redrawing
+        if (idle && !XPending(display)) {
+            wait_for_events(display, app->shaders.watch_fd);
+            reset_frame_pacer(&app->pacer);
+            hud_begin_phase(&app->hud);
+        }
+        reload_shader_library(&app->shaders);
         
         XEvent event;
+        PointerInput pointer = {0};
         while (XPending(display)) {
             XNextEvent(display, &event);
+            if (translate_pointer_event(&app->pointer, display, &event, &pointer)) {
+                continue;
+            }
             
             switch (event.type) {
-            case MotionNotify:
-                mouse.curr = (Vec2f){(float)event.xmotion.x, (float)event.xmotion.y};
-                if (mouse.drag) {
-                    Vec2f delta = vec2_sub(world(&camera, mouse.prev), world(&camera, mouse.curr));
-                    camera.position = vec2_add(camera.position, delta);
-                    camera.target_position = camera.position;                    
-                    camera.velocity = vec2_mul(delta, (float)rate);
-                }
-                mouse.prev = mouse.curr;
-                break;
-                    
             case KeyPress: {
                 KeySym key = XLookupKeysym(&event.xkey, 0);
                 if (key == XK_q || key == XK_Escape) {
@@ -559,7 +508,23 @@ int main(int argc, char** argv) {
                     } else {
                         // Disable color picker mode
                         XUndefineCursor(display, win);
+                        color_picker.selecting = false;
+                        color_picker.has_selection = false;
                     }
+                } else if (key == XK_s) {
+                    save_visible_region(&app->screenshot, &camera, window_size);
+                } else if (key == XK_y) {
+                    copy_visible_region(&app->screenshot, &camera, window_size);
+                } else if (key == XK_F3) {
+                    toggle_hud(&app->hud);
+                } else if (key == XK_m && app->monitor >= 0 && app->monitor_count > 1) {
+                    switch_monitor(app, (app->monitor + 1) % app->monitor_count);
+                    camera.scale = 1.0f;
+                    camera.target_scale = 1.0f;
+                    camera.delta_scale = 0.0f;
+                    camera.position = (Vec2f){0, 0};
+                    camera.target_position = (Vec2f){0, 0};
+                    camera.velocity = (Vec2f){0, 0};
                 } else if (key == XK_0) {
                     if (config.lerp_camera_recenter) {
                         camera.target_position = (Vec2f){0, 0};
@@ -579,10 +544,7 @@ int main(int argc, char** argv) {
                     flashlight.animating = true;
         
                     if (flashlight.is_enabled) {
-                        XWindowAttributes current_wa;
-                        XGetWindowAttributes(display, win, &current_wa);
-                        max_screen_dimension = fmaxf(current_wa.width, current_wa.height) * 1.5f;
-                        flashlight.radius = max_screen_dimension;
+                        flashlight.radius = fmaxf(window_size.x, window_size.y) * 1.5f;
                         flashlight.target_radius = 200.0f;
         
                         if (config.hide_cursor_on_flashlight) {
@@ -627,10 +589,21 @@ int main(int argc, char** argv) {
             }
             
             case ButtonPress:
+                // Buttons act where the pointer is now, not where the frame started
+                apply_pointer_motion(&pointer, &mouse, &camera, dt);
                 if (color_picker.is_enabled && event.xbutton.button == Button1) {
                     // Print color and exit
-                    printf("#%02X%02X%02X\n", color_picker.r, color_picker.g, color_picker.b);
+                    fprintf(out, "#%02X%02X%02X\n", color_picker.r, color_picker.g, color_picker.b);
+                    fflush(out);
                     running = false;
+                } else if (color_picker.is_enabled && event.xbutton.button == Button3) {
+                    // Start a new region, the stats follow the pointer until release
+                    Vec2f p = screenshot_point(&camera, mouse.curr, window_size);
+                    color_picker.x0 = color_picker.x1 = (int)p.x;
+                    color_picker.y0 = color_picker.y1 = (int)p.y;
+                    color_picker.selecting = true;
+                    color_picker.has_selection = true;
+                    memset(color_picker.computed, 0, sizeof(color_picker.computed));
                 } else if (!color_picker.is_enabled && event.xbutton.button == Button1) {
                     mouse.prev = mouse.curr;
                     mouse.drag = true;
@@ -669,42 +642,565 @@ int main(int argc, char** argv) {
                 break;
             
             case ButtonRelease:
+                apply_pointer_motion(&pointer, &mouse, &camera, dt);
                 if (event.xbutton.button == Button1 && !color_picker.is_enabled) {
                     mouse.drag = false;
+                } else if (event.xbutton.button == Button3) {
+                    color_picker.selecting = false;
                 }
                 break;
             
+            case MapNotify:
+                mapped = mapped || event.xmap.window == win;
+                break;
+
+            case ConfigureNotify:
+                if (event.xconfigure.window == win) {
+                    window_size = (Vec2f){(float)event.xconfigure.width, (float)event.xconfigure.height};
+                } else {
+                    screenshot_handle_event(&app->screenshot, &event);
+                }
+                break;
+
             case ClientMessage:
                 if ((Atom)event.xclient.data.l[0] == wm_delete) {
                     running = false;
                 }
                 break;
+
+            default:
+                screenshot_handle_event(&app->screenshot, &event);
+                break;
             }
         }
+
+        apply_pointer_motion(&pointer, &mouse, &camera, dt);
+
+        // Smooth scrolling zooms in proportion to the distance scrolled
+        if (pointer.control_scroll != 0.0f && flashlight.is_enabled) {
+            flashlight.delta_radius += pointer.control_scroll * INITIAL_FL_DELTA_RADIUS;
+            flashlight.animating = false;
+        } else {
+            pointer.scroll += pointer.control_scroll;
+        }
+        if (pointer.scroll != 0.0f) {
+            camera.delta_scale += pointer.scroll * config.scroll_speed;
+            camera.scale_pivot = mouse.curr;
+        }
     
-        update_camera(&camera, dt, &mouse, (Vec2f){(float)wa.width, (float)wa.height});
+        hud_end_phase(&app->hud, HUD_PHASE_EVENTS);
+
+        dt = begin_frame(&app->pacer);
+        update_camera(&camera, dt, &mouse, window_size);
         update_flashlight(&flashlight, dt, mouse.curr);
         
+#ifdef LIVE
+        refresh_screenshot(&app->screenshot, display, tracking_window);
+        update_renderer(&app->renderer, &app->screenshot);
+#endif
+
         if (color_picker.is_enabled) {
-            update_color_picker(&color_picker, &screenshot, &camera, mouse.curr, (Vec2f){(float)wa.width, (float)wa.height});
+            update_color_picker(&color_picker, &app->screenshot, &camera, mouse.curr, window_size);
         }
     
-        draw_scene(&screenshot, &camera, shader_program, vao,
-                   (Vec2f){(float)wa.width, (float)wa.height}, &flashlight);
+        hud_end_phase(&app->hud, HUD_PHASE_UPDATE);
     
+        hud_begin_gpu(&app->hud);
+        draw_scene(&app->renderer, &app->screenshot, &camera, &flashlight,
+                   window_size);
+        hud_end_gpu(&app->hud);
+        hud_end_phase(&app->hud, HUD_PHASE_DRAW);
+
+        if (color_picker.is_enabled && color_picker.has_selection) {
+            draw_color_stats(&app->overlay, &color_picker, &camera, window_size);
+        }
+
+        if (app->hud.visible) {
+            draw_hud(&app->hud, window_size,
+                     renderer_memory(&app->renderer), frame_round_trips);
+        }
+    
+        if (app->recorder) {
+            record_frame(app->recorder, (int)window_size.x, (int)window_size.y, monotonic_seconds());
+        }
         glXSwapBuffers(display, win);
-        glFinish();
+        end_frame(&app->pacer);
+        if (first_frame) {
+            log_timing("first frame");
+            first_frame = false;
+        }
+        hud_end_phase(&app->hud, HUD_PHASE_SWAP);
+        hud_end_frame(&app->hud, app->pacer.frame_time);
+
+        idle = camera_is_idle(&camera, &mouse) && flashlight_is_idle(&flashlight);
+#ifdef LIVE
+        idle = idle && !capture_pending(&app->screenshot);
+#endif
     }
 
-    destroy_screenshot(&screenshot);
-    glDeleteVertexArrays(1, &vao);
-    glDeleteBuffers(1, &vbo);
-    glDeleteBuffers(1, &ebo);
-    glDeleteProgram(shader_program);
+    if (!windowed) {
+        XUngrabKeyboard(display, CurrentTime);
+    }
+    XUndefineCursor(display, win);
+    XUnmapWindow(display, win);
+    XFlush(display);
+}
 
-    glXDestroyContext(display, glc);
-    XDestroyWindow(display, win);
-    XCloseDisplay(display);
+static volatile sig_atomic_t daemon_running = 1;
+
+static void stop_daemon(int signal) {
+    (void)signal;
+    daemon_running = 0;
+}
+
+// Stay resident with the window unmapped, zoom whenever the hotkey is
+// pressed or a client writes "zoom" or "pick" to the control socket
+static int run_daemon(App* app, bool verbose) {
+    Display* display = app->display;
+
+    bool already_running;
+    int control = open_control_socket(&already_running);
+    if (already_running) {
+        return 1;
+    }
+
+    Hotkey hotkey;
+    bool has_hotkey = parse_hotkey(display, config.daemon_hotkey, &hotkey) &&
+        grab_hotkey(display, app->tracking_window, &hotkey);
+    if (!has_hotkey) {
+        fprintf(stderr, "Could not grab hotkey %s, only the control socket will activate\n",
+                config.daemon_hotkey);
+    }
+    if (!has_hotkey && control < 0) {
+        return 1;
+    }
+
+    struct sigaction action = {0};
+    action.sa_handler = stop_daemon;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
 
+    printf("zoomer is resident, press %s or run zoomer --activate\n", config.daemon_hotkey);
+    fflush(stdout);
+
+    while (daemon_running) {
+        struct pollfd fds[2] = {
+            {.fd = ConnectionNumber(display), .events = POLLIN},
+            {.fd = control, .events = POLLIN},
+        };
+        if (!XPending(display) && poll(fds, control >= 0 ? 2 : 1, -1) < 0) {
+            continue;  // Interrupted, check whether it was a stop signal
+        }
+
+        while (XPending(display)) {
+            XEvent event;
+            XNextEvent(display, &event);
+            if (event.type == KeyPress && has_hotkey && hotkey_matches(&hotkey, &event.xkey)) {
+                begin_timing(verbose);
+                recapture(app);
+                run_session(app, false, stdout);
+            } else {
+                screenshot_handle_event(&app->screenshot, &event);
+            }
+        }
+
+        if (control >= 0 && (fds[1].revents & POLLIN)) {
+            int client = accept_control_client(control);
+            if (client < 0) continue;
+
+            char message[64] = {0};
+            ssize_t n = read(client, message, sizeof(message) - 1);
+            FILE* out = fdopen(client, "w");
+            if (n > 0 && out) {
+                begin_timing(verbose);
+                recapture(app);
+                run_session(app, strncmp(message, "pick", 4) == 0, out);
+            }
+            if (out) {
+                fclose(out);
+            } else {
+                close(client);
+            }
+        }
+    }
+
+    if (has_hotkey) {
+        ungrab_hotkey(display, app->tracking_window, &hotkey);
+    }
+    if (control >= 0) {
+        close_control_socket(control);
+    }
     return 0;
 }
+
+static void print_usage(void) {
+    printf("Usage: zoomer [OPTIONS]\n");
+    printf("  -d, --delay <seconds>     delay execution by <seconds>\n");
+    printf("  -h, --help                show this help\n");
+    printf("  -c, --config <filepath>   use config at <filepath>\n");
+    printf("  -w, --windowed            windowed mode\n");
+    printf("  -p, --pick                start in color picker mode\n");
+    printf("  -m, --monitor             capture only the monitor under the cursor\n");
+    printf("  -s, --screen-shot         copy a screenshot to the clipboard and exit without zooming\n");
+    printf("  -o, --output <filepath>   write the -s screenshot to <filepath> instead, - for stdout\n");
+    printf("  --format <png|ppm|raw>    format for -s (default: from the -o extension, else png)\n");
+    printf("  --record <filepath>       record the session to <filepath>, - for stdout\n");
+    printf("  --record-format <y4m|raw> format for --record (default: from the extension, else y4m)\n");
+    printf("  -v, --verbose             print startup phase timings\n");
+    printf("  --daemon                  stay resident, zoom on the hotkey or --activate\n");
+    printf("  --activate                make a running daemon zoom (with -p: pick a color)\n");
+    printf("  --new-config [filepath]   generate default config\n");
+    printf("  --bench                   render benchmark scenarios offscreen, print JSON\n");
+    printf("  --bench-size <WxH>        benchmark render size (default: screen size)\n");
+    printf("  --bench-frames <n>        measured frames per benchmark scenario\n");
+    printf("  --bench-capture           benchmark a screen capture instead of a synthetic image\n");
+}
+
+int main(int argc, char** argv) {
+    bool windowed = false;
+    float delay_sec = 0.0f;
+    char config_file[512] = {0};
+    bool start_in_picker_mode = false;
+    bool per_monitor = false;
+    bool verbose = false;
+    bool resident = false;
+    bool activate = false;
+    bool bench = false;
+    bool screen_shot = false;
+    const char* output_path = NULL;
+    bool has_format = false;
+    ExportFormat format = EXPORT_PNG;
+    const char* record_path = NULL;
+    bool has_record_format = false;
+    RecordFormat record_format = RECORD_Y4M;
+    BenchOptions bench_options = {0};
+
+
+    const char* home = getenv("HOME");
+    if (home) {
+        snprintf(config_file, sizeof(config_file), "%s/.config/zoomer/config", home);
+    }
+    
+    // The detached clipboard owner, see copy_image_to_clipboard()
+    if (argc == 2 && strcmp(argv[1], "--serve-clipboard") == 0) {
+        return serve_clipboard(stdin);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--delay") == 0) {
+            if (i + 1 < argc) {
+                delay_sec = atof(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "--windowed") == 0) {
+            windowed = true;
+        } else if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--pick") == 0) {
+            start_in_picker_mode = true;
+        } else if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--monitor") == 0) {
+            per_monitor = true;
+        } else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--screen-shot") == 0) {
+            screen_shot = true;
+        } else if (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) {
+            if (i + 1 < argc) {
+                output_path = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--format") == 0) {
+            if (i + 1 < argc) {
+                has_format = parse_export_format(argv[++i], &format);
+                if (!has_format) {
+                    fprintf(stderr, "Unknown format: %s\n", argv[i]);
+                    return 1;
+                }
+            }
+        } else if (strcmp(argv[i], "--record") == 0) {
+            if (i + 1 < argc) {
+                record_path = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--record-format") == 0) {
+            if (i + 1 < argc) {
+                has_record_format = parse_record_format(argv[++i], &record_format);
+                if (!has_record_format) {
+                    fprintf(stderr, "Unknown recording format: %s\n", argv[i]);
+                    return 1;
+                }
+            }
+        } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_usage();
+            return 0;
+        } else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--config") == 0) {
+            if (i + 1 < argc) {
+                strncpy(config_file, argv[++i], sizeof(config_file) - 1);
+            }
+        } else if (strcmp(argv[i], "--daemon") == 0) {
+            resident = true;
+        } else if (strcmp(argv[i], "--activate") == 0) {
+            activate = true;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (strcmp(argv[i], "--bench-size") == 0) {
+            if (i + 1 < argc) {
+                sscanf(argv[++i], "%dx%d", &bench_options.width, &bench_options.height);
+            }
+        } else if (strcmp(argv[i], "--bench-frames") == 0) {
+            if (i + 1 < argc) {
+                bench_options.frames = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--bench-capture") == 0) {
+            bench_options.capture = true;
+        } else if (strcmp(argv[i], "--new-config") == 0) {
+            const char* path = (i + 1 < argc) ? argv[i + 1] : config_file;
+            generate_default_config(path);
+            printf("Generated config at %s\n", path);
+            return 0;
+        }
+    }
+    
+    if (activate) {
+        return send_control_message(start_in_picker_mode ? "pick\n" : "zoom\n");
+    }
+
+    if (record_path && resident) {
+        fprintf(stderr, "--record records a single session and cannot be combined with --daemon\n");
+        return 1;
+    }
+
+    // Status messages go to stdout, keep them out of a recording written there
+    FILE* record_out = NULL;
+    if (record_path) {
+        if (strcmp(record_path, "-") == 0) {
+            fflush(stdout);
+            int stream = dup(STDOUT_FILENO);
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+            record_out = stream >= 0 ? fdopen(stream, "wb") : NULL;
+        } else {
+            record_out = fopen(record_path, "wb");
+        }
+        if (!record_out) {
+            fprintf(stderr, "Could not open %s for recording: %s\n", record_path, strerror(errno));
+            return 1;
+        }
+    }
+    
+    if (delay_sec > 0.0f) {
+        struct timespec ts;
+        ts.tv_sec = (time_t)delay_sec;
+        ts.tv_nsec = (long)((delay_sec - ts.tv_sec) * 1000000000);
+        nanosleep(&ts, NULL);
+    }
+
+    begin_timing(verbose);
+    
+    config = load_config(config_file);
+    per_monitor = per_monitor || config.per_monitor;
+    log_timing("config");
+
+    // The initial capture shares the connection with the main thread
+    XInitThreads();
+    
+    Display* display = XOpenDisplay(NULL);
+    if (!display) {
+        fprintf(stderr, "Failed to open display\n");
+        return 1;
+    }
+    log_timing("open display");
+
+    if (bench) {
+        int result = run_bench(display, &bench_options);
+        XCloseDisplay(display);
+        return result;
+    }
+    
+    App app = {
+        .display = display,
+        .tracking_window = DefaultRootWindow(display),
+        .windowed = windowed,
+        .monitor = -1,
+    };
+
+    // In per monitor mode only the CRTC under the cursor is captured and covered
+    if (per_monitor) {
+        app.monitor_count = list_monitors(display, app.tracking_window, app.monitors, MAX_MONITORS);
+        if (app.monitor_count > 0) {
+            Vec2f pointer = get_cursor_position(display, app.tracking_window);
+            app.monitor = monitor_at(app.monitors, app.monitor_count, (int)pointer.x, (int)pointer.y);
+        } else {
+            fprintf(stderr, "XRandR reports no active monitors, capturing the whole screen\n");
+        }
+    }
+
+    // Export straight from the capture, no window or GL context needed
+    if (screen_shot) {
+        Screenshot screenshot = app.monitor >= 0
+            ? create_screenshot_area(display, app.tracking_window, app.monitors[app.monitor].x,
+                                     app.monitors[app.monitor].y, app.monitors[app.monitor].width,
+                                     app.monitors[app.monitor].height)
+            : create_screenshot(display, app.tracking_window);
+        log_timing("capture");
+
+        bool ok;
+        if (output_path) {
+            if (!has_format) {
+                format = export_format_for_path(output_path);
+            }
+            ok = export_image_to_path(screenshot.image, 0, 0, screenshot.image->width,
+                                      screenshot.image->height, format, output_path);
+            if (ok && strcmp(output_path, "-") != 0) {
+                fprintf(stderr, "Saved screenshot to %s\n", output_path);
+            }
+        } else {
+            // Served from a background process, zoomer itself exits right away
+            ok = copy_image_to_clipboard(screenshot.image, 0, 0, screenshot.image->width,
+                                         screenshot.image->height);
+        }
+        log_timing("export");
+
+        destroy_screenshot(&screenshot, display);
+        XCloseDisplay(display);
+        return ok ? 0 : 1;
+    }
+
+    CaptureJob capture = {
+        .display = display,
+        .window = app.tracking_window,
+        .area = app.monitor >= 0 ? app.monitors[app.monitor] : (Monitor){0},
+        .use_area = app.monitor >= 0,
+    };
+    start_capture(&capture);
+    log_timing("start capture");
+    
+    XRRScreenConfiguration* screen_config = XRRGetScreenInfo(display, DefaultRootWindow(display));
+    short rate = XRRConfigCurrentRate(screen_config);
+    XRRFreeScreenConfigInfo(screen_config);
+    if (app.monitor >= 0 && app.monitors[app.monitor].rate > 0.0f) {
+        rate = (short)(app.monitors[app.monitor].rate + 0.5f);
+    }
+    
+    if (rate < 30 || rate > 500) {
+        rate = 60;
+        printf("Screen rate detection failed, using default: 60 Hz\n");
+    } else {
+        printf("Screen rate: %d Hz\n", rate);
+    }
+    
+    int screen = DefaultScreen(display);
+    
+    GLint glx_attrs[] = {
+        GLX_RGBA,
+        GLX_DEPTH_SIZE, 24,
+        GLX_DOUBLEBUFFER,
+        None
+    };
+    
+    XVisualInfo* vi = glXChooseVisual(display, screen, glx_attrs);
+    if (!vi) {
+        fprintf(stderr, "No appropriate visual found\n");
+        return 1;
+    }
+    
+    XSetWindowAttributes swa = {0};
+    swa.colormap = XCreateColormap(display, DefaultRootWindow(display), vi->visual, AllocNone);
+    swa.event_mask = ButtonPressMask | ButtonReleaseMask | KeyPressMask | KeyReleaseMask |
+        PointerMotionMask | ExposureMask | StructureNotifyMask;
+    if (!windowed) {
+        swa.override_redirect = True;
+        swa.save_under = True;
+    }
+    
+    XWindowAttributes root_attrs;
+    XGetWindowAttributes(display, DefaultRootWindow(display), &root_attrs);
+    Monitor area = app.monitor >= 0
+        ? app.monitors[app.monitor]
+        : (Monitor){0, 0, root_attrs.width, root_attrs.height, rate};
+    
+    app.win = XCreateWindow(display, DefaultRootWindow(display),
+                            area.x, area.y, area.width, area.height, 0,
+                            vi->depth, InputOutput, vi->visual,
+                            CWColormap | CWEventMask | CWOverrideRedirect | CWSaveUnder,
+                            &swa);
+    
+    XStoreName(display, app.win, "zoomer");
+    create_pointer_devices(&app.pointer, display, app.win);
+    
+    app.wm_delete = XInternAtom(display, "WM_DELETE_WINDOW", False);
+    XSetWMProtocols(display, app.win, &app.wm_delete, 1);
+    log_timing("create window");
+    
+    app.glc = glXCreateContext(display, vi, NULL, GL_TRUE);
+    glXMakeCurrent(display, app.win, app.glc);
+    log_timing("glx context");
+    
+    glewExperimental = GL_TRUE;
+    GLenum glew_err = glewInit();
+    if (glew_err != GLEW_OK) {
+        fprintf(stderr, "GLEW initialization failed: %s\n", glewGetErrorString(glew_err));
+        return 1;
+    }
+    printf("OpenGL version: %s\n", glGetString(GL_VERSION));
+    log_timing("glew");
+    
+    create_shader_library(&app.shaders, config.vertex_shader_path, config.fragment_shader_path);
+    
+    printf("Loaded vertex shader:   %s\n", app.shaders.vertex.path);
+    printf("Loaded fragment shader: %s\n", app.shaders.fragment.path);
+    
+    // The first frame draws without the flashlight, the other variants link when first needed
+    shader_variant(&app.shaders, 0);
+    log_timing("shaders");
+    
+    app.screenshot = finish_capture(&capture);
+    // The capture thread is done with the display, from here on it is only used here
+    watch_round_trips(display);
+    if (verbose) {
+        fprintf(stderr, "timing: capture finished at %.2f ms\n", (capture.finished - timing.start) * 1000.0);
+    }
+    log_timing("wait for capture");
+
+    create_renderer(&app.renderer, &app.shaders, &app.screenshot);
+    log_timing("upload");
+
+    app.crosshair_cursor = XCreateFontCursor(display, XC_crosshair);
+    create_frame_pacer(&app.pacer, display, app.win, 1.0f / (float)rate, config.vsync, config.max_frames_in_flight);
+    create_hud(&app.hud);
+    create_overlay(&app.overlay);
+
+    Recorder recorder;
+    if (record_path) {
+        if (!has_record_format) {
+            record_format = record_format_for_path(record_path);
+        }
+        double fps = config.record_fps > 0.0f ? config.record_fps : rate;
+        if (!start_recorder(&recorder, record_out, record_format, fps)) {
+            return 1;
+        }
+        // A closed pipe ends the recording, not zoomer
+        signal(SIGPIPE, SIG_IGN);
+        app.recorder = &recorder;
+    }
+
+    int result = 0;
+    if (resident) {
+        result = run_daemon(&app, verbose);
+    } else {
+        // The window is only mapped now, after the screen behind it was captured
+        run_session(&app, start_in_picker_mode, stdout);
+    }
+
+    if (app.recorder) {
+        stop_recorder(app.recorder, monotonic_seconds());
+    }
+
+    destroy_overlay(&app.overlay);
+    destroy_hud(&app.hud);
+    destroy_frame_pacer(&app.pacer);
+    destroy_renderer(&app.renderer);
+    destroy_screenshot(&app.screenshot, display);
+    destroy_shader_library(&app.shaders);
+
+    glXDestroyContext(display, app.glc);
+    XDestroyWindow(display, app.win);
+    XCloseDisplay(display);
+
+    return result;
+}
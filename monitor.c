@@ -0,0 +1,53 @@
+#include "monitor.h"
+#include <X11/extensions/Xrandr.h>
+
+static float mode_rate(const XRRScreenResources* resources, RRMode id) {
+    for (int i = 0; i < resources->nmode; i++) {
+        const XRRModeInfo* mode = &resources->modes[i];
+        if (mode->id != id) continue;
+
+        if (mode->hTotal == 0 || mode->vTotal == 0) return 0.0f;
+        double rate = (double)mode->dotClock / ((double)mode->hTotal * mode->vTotal);
+        if (mode->modeFlags & RR_Interlace) rate *= 2.0;
+        if (mode->modeFlags & RR_DoubleScan) rate /= 2.0;
+        return (float)rate;
+    }
+    return 0.0f;
+}
+
+// Fill `monitors` with every CRTC that is driving an output, returns how many
+int list_monitors(Display* display, Window root, Monitor* monitors, int max_monitors) {
+    XRRScreenResources* resources = XRRGetScreenResourcesCurrent(display, root);
+    if (!resources) {
+        return 0;
+    }
+
+    int count = 0;
+    for (int i = 0; i < resources->ncrtc && count < max_monitors; i++) {
+        XRRCrtcInfo* crtc = XRRGetCrtcInfo(display, resources, resources->crtcs[i]);
+        if (!crtc) continue;
+
+        if (crtc->mode != None && crtc->width > 0 && crtc->height > 0) {
+            monitors[count++] = (Monitor){
+                crtc->x, crtc->y,
+                (int)crtc->width, (int)crtc->height,
+                mode_rate(resources, crtc->mode)
+            };
+        }
+        XRRFreeCrtcInfo(crtc);
+    }
+
+    XRRFreeScreenResources(resources);
+    return count;
+}
+
+// Index of the monitor containing the point, the first one when none does
+int monitor_at(const Monitor* monitors, int count, int x, int y) {
+    for (int i = 0; i < count; i++) {
+        const Monitor* m = &monitors[i];
+        if (x >= m->x && x < m->x + m->width && y >= m->y && y < m->y + m->height) {
+            return i;
+        }
+    }
+    return 0;
+}
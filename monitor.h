@@ -0,0 +1,17 @@
+#pragma once
+
+#include <X11/Xlib.h>
+
+#define MAX_MONITORS 16
+
+// One active XRandR CRTC, in root window coordinates
+typedef struct {
+    int x;
+    int y;
+    int width;
+    int height;
+    float rate;  // Refresh rate of the current mode in Hz, 0 when unknown
+} Monitor;
+
+int list_monitors(Display* display, Window root, Monitor* monitors, int max_monitors);
+int monitor_at(const Monitor* monitors, int count, int x, int y);
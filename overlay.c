@@ -0,0 +1,208 @@
+#include "overlay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#define FLOATS_PER_VERTEX 6
+
+static const char* overlay_vertex_source =
+    "#version 130\n"
+    "in vec2 aPos;\n"
+    "in vec4 aColor;\n"
+    "out vec4 vColor;\n"
+    "uniform vec2 windowSize;\n"
+    "void main() {\n"
+    "    vec2 ndc = aPos / windowSize * 2.0 - 1.0;\n"
+    "    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);\n"
+    "    vColor = aColor;\n"
+    "}\n";
+
+static const char* overlay_fragment_source =
+    "#version 130\n"
+    "in vec4 vColor;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "    color = vColor;\n"
+    "}\n";
+
+// 5x7 glyphs, one byte per row with the leftmost pixel in bit 4.
+// Lowercase letters are drawn with the uppercase glyphs.
+static const unsigned char font[128][OVERLAY_GLYPH_HEIGHT] = {
+    ['!'] = {0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x04},
+    ['#'] = {0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A},
+    ['%'] = {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03},
+    ['('] = {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02},
+    [')'] = {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08},
+    ['+'] = {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00},
+    [','] = {0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08},
+    ['-'] = {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00},
+    ['.'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C},
+    ['/'] = {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00},
+    ['0'] = {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E},
+    ['1'] = {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E},
+    ['2'] = {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F},
+    ['3'] = {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E},
+    ['4'] = {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02},
+    ['5'] = {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E},
+    ['6'] = {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E},
+    ['7'] = {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},
+    ['8'] = {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E},
+    ['9'] = {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C},
+    [':'] = {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00},
+    ['<'] = {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02},
+    ['='] = {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00},
+    ['>'] = {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08},
+    ['?'] = {0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04},
+    ['A'] = {0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11},
+    ['B'] = {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E},
+    ['C'] = {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E},
+    ['D'] = {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C},
+    ['E'] = {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F},
+    ['F'] = {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10},
+    ['G'] = {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F},
+    ['H'] = {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},
+    ['I'] = {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E},
+    ['J'] = {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C},
+    ['K'] = {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11},
+    ['L'] = {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F},
+    ['M'] = {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11},
+    ['N'] = {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},
+    ['O'] = {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},
+    ['P'] = {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10},
+    ['Q'] = {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D},
+    ['R'] = {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11},
+    ['S'] = {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E},
+    ['T'] = {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},
+    ['U'] = {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},
+    ['V'] = {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04},
+    ['W'] = {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A},
+    ['X'] = {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11},
+    ['Y'] = {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04},
+    ['Z'] = {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F},
+    ['['] = {0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E},
+    [']'] = {0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E},
+    ['_'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F},
+};
+
+static GLuint compile_overlay_shader(const char* source, GLenum type) {
+    GLuint id = glCreateShader(type);
+    glShaderSource(id, 1, &source, NULL);
+    glCompileShader(id);
+
+    GLint success;
+    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char log[512];
+        glGetShaderInfoLog(id, sizeof(log), NULL, log);
+        fprintf(stderr, "Overlay shader compilation error:\n%s\n", log);
+    }
+
+    return id;
+}
+
+void create_overlay(Overlay* overlay) {
+    GLuint vs = compile_overlay_shader(overlay_vertex_source, GL_VERTEX_SHADER);
+    GLuint fs = compile_overlay_shader(overlay_fragment_source, GL_FRAGMENT_SHADER);
+
+    overlay->program = glCreateProgram();
+    glAttachShader(overlay->program, vs);
+    glAttachShader(overlay->program, fs);
+    glBindAttribLocation(overlay->program, 0, "aPos");
+    glBindAttribLocation(overlay->program, 1, "aColor");
+    glLinkProgram(overlay->program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    glGenVertexArrays(1, &overlay->vao);
+    glGenBuffers(1, &overlay->vbo);
+    glBindVertexArray(overlay->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, overlay->vbo);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float),
+                          (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+
+    overlay->vertices = NULL;
+    overlay->count = 0;
+    overlay->capacity = 0;
+}
+
+void destroy_overlay(Overlay* overlay) {
+    glDeleteProgram(overlay->program);
+    glDeleteVertexArrays(1, &overlay->vao);
+    glDeleteBuffers(1, &overlay->vbo);
+    free(overlay->vertices);
+    overlay->vertices = NULL;
+}
+
+static void push_vertex(Overlay* overlay, float x, float y, Rgba color) {
+    if (overlay->count == overlay->capacity) {
+        overlay->capacity = overlay->capacity ? overlay->capacity * 2 : 1024;
+        overlay->vertices = realloc(overlay->vertices,
+                                    overlay->capacity * FLOATS_PER_VERTEX * sizeof(float));
+    }
+
+    float* v = overlay->vertices + overlay->count * FLOATS_PER_VERTEX;
+    v[0] = x;
+    v[1] = y;
+    v[2] = color.r;
+    v[3] = color.g;
+    v[4] = color.b;
+    v[5] = color.a;
+    overlay->count++;
+}
+
+void overlay_rect(Overlay* overlay, float x, float y, float w, float h, Rgba color) {
+    push_vertex(overlay, x, y, color);
+    push_vertex(overlay, x + w, y, color);
+    push_vertex(overlay, x + w, y + h, color);
+    push_vertex(overlay, x, y, color);
+    push_vertex(overlay, x + w, y + h, color);
+    push_vertex(overlay, x, y + h, color);
+}
+
+// Returns the width of the drawn text in pixels
+float overlay_text(Overlay* overlay, float x, float y, float scale, Rgba color, const char* text) {
+    float advance = (OVERLAY_GLYPH_WIDTH + 1) * scale;
+    float start = x;
+
+    for (const char* c = text; *c; c++) {
+        unsigned char ch = (unsigned char)toupper((unsigned char)*c);
+        if (ch < 128) {
+            for (int row = 0; row < OVERLAY_GLYPH_HEIGHT; row++) {
+                unsigned char bits = font[ch][row];
+                for (int col = 0; col < OVERLAY_GLYPH_WIDTH; col++) {
+                    if (bits & (0x10 >> col)) {
+                        overlay_rect(overlay, x + col * scale, y + row * scale, scale, scale, color);
+                    }
+                }
+            }
+        }
+        x += advance;
+    }
+
+    return x - start;
+}
+
+void flush_overlay(Overlay* overlay, Vec2f window_size) {
+    if (overlay->count == 0) {
+        return;
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glUseProgram(overlay->program);
+    glUniform2f(glGetUniformLocation(overlay->program, "windowSize"), window_size.x, window_size.y);
+
+    glBindVertexArray(overlay->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, overlay->vbo);
+    glBufferData(GL_ARRAY_BUFFER, overlay->count * FLOATS_PER_VERTEX * sizeof(float),
+                 overlay->vertices, GL_STREAM_DRAW);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)overlay->count);
+
+    glDisable(GL_BLEND);
+    overlay->count = 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <GL/glew.h>
+#include "la.h"
+
+#define OVERLAY_GLYPH_WIDTH 5
+#define OVERLAY_GLYPH_HEIGHT 7
+
+typedef struct {
+    float r, g, b, a;
+} Rgba;
+
+// Batches flat colored rectangles and bitmap text in window pixel coordinates
+// (origin top left) and draws them in one call on top of the scene.
+typedef struct {
+    GLuint program;
+    GLuint vao;
+    GLuint vbo;
+    float* vertices;
+    size_t count;
+    size_t capacity;
+} Overlay;
+
+void create_overlay(Overlay* overlay);
+void destroy_overlay(Overlay* overlay);
+void overlay_rect(Overlay* overlay, float x, float y, float w, float h, Rgba color);
+float overlay_text(Overlay* overlay, float x, float y, float scale, Rgba color, const char* text);
+void flush_overlay(Overlay* overlay, Vec2f window_size);
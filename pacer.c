@@ -0,0 +1,121 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pacer.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Longest step fed to the physics, so a stalled frame doesn't blow up the springs
+#define MAX_FRAME_DT (1.0f / 20.0f)
+#define FENCE_TIMEOUT_NS 100000000ull
+
+double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static bool has_extension(const char* extensions, const char* name) {
+    size_t length = strlen(name);
+    const char* p = extensions;
+    while (p && (p = strstr(p, name))) {
+        bool starts = p == extensions || p[-1] == ' ';
+        bool ends = p[length] == ' ' || p[length] == '\0';
+        if (starts && ends) {
+            return true;
+        }
+        p += length;
+    }
+    return false;
+}
+
+static void set_swap_interval(Display* display, GLXDrawable drawable, int interval) {
+    const char* extensions = glXQueryExtensionsString(display, DefaultScreen(display));
+
+    if (has_extension(extensions, "GLX_EXT_swap_control")) {
+        PFNGLXSWAPINTERVALEXTPROC swap_interval = (PFNGLXSWAPINTERVALEXTPROC)
+            glXGetProcAddressARB((const GLubyte*)"glXSwapIntervalEXT");
+        if (swap_interval) {
+            swap_interval(display, drawable, interval);
+            return;
+        }
+    }
+
+    if (has_extension(extensions, "GLX_MESA_swap_control")) {
+        PFNGLXSWAPINTERVALMESAPROC swap_interval = (PFNGLXSWAPINTERVALMESAPROC)
+            glXGetProcAddressARB((const GLubyte*)"glXSwapIntervalMESA");
+        if (swap_interval) {
+            swap_interval(interval);
+            return;
+        }
+    }
+
+    // SGI can only turn vsync on, which is the driver default anyway
+    if (interval > 0 && has_extension(extensions, "GLX_SGI_swap_control")) {
+        PFNGLXSWAPINTERVALSGIPROC swap_interval = (PFNGLXSWAPINTERVALSGIPROC)
+            glXGetProcAddressARB((const GLubyte*)"glXSwapIntervalSGI");
+        if (swap_interval) {
+            swap_interval(interval);
+            return;
+        }
+    }
+
+    fprintf(stderr, "Swap control is not supported, using the driver's vsync setting\n");
+}
+
+void create_frame_pacer(FramePacer* pacer, Display* display, GLXDrawable drawable,
+                        float nominal_dt, bool vsync, int max_frames_in_flight) {
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->nominal_dt = nominal_dt;
+
+    if (max_frames_in_flight < 0) max_frames_in_flight = 0;
+    if (max_frames_in_flight > MAX_FRAMES_IN_FLIGHT) max_frames_in_flight = MAX_FRAMES_IN_FLIGHT;
+    pacer->max_frames_in_flight = max_frames_in_flight;
+
+    set_swap_interval(display, drawable, vsync ? 1 : 0);
+    reset_frame_pacer(pacer);
+}
+
+void destroy_frame_pacer(FramePacer* pacer) {
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (pacer->fences[i]) {
+            glDeleteSync(pacer->fences[i]);
+            pacer->fences[i] = NULL;
+        }
+    }
+}
+
+// Forget the time spent sleeping, the next frame steps by the nominal dt
+void reset_frame_pacer(FramePacer* pacer) {
+    pacer->last_time = monotonic_seconds() - pacer->nominal_dt;
+}
+
+// Returns the time since the previous frame started, clamped for the
+// simulation. The raw measurement is kept in frame_time.
+float begin_frame(FramePacer* pacer) {
+    double now = monotonic_seconds();
+    float dt = (float)(now - pacer->last_time);
+    pacer->last_time = now;
+    pacer->frame_time = dt;
+
+    if (dt > MAX_FRAME_DT) dt = MAX_FRAME_DT;
+    if (dt < 1e-4f) dt = 1e-4f;
+    return dt;
+}
+
+// Call right after glXSwapBuffers. Waits only when more than
+// max_frames_in_flight frames are still queued on the GPU.
+void end_frame(FramePacer* pacer) {
+    if (pacer->max_frames_in_flight == 0) {
+        return;
+    }
+
+    int slot = pacer->fence_index;
+    if (pacer->fences[slot]) {
+        glClientWaitSync(pacer->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+        glDeleteSync(pacer->fences[slot]);
+    }
+
+    pacer->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pacer->fence_index = (slot + 1) % pacer->max_frames_in_flight;
+}
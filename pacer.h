@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdbool.h>
+#include <GL/glew.h>
+#include <GL/glx.h>
+
+#define MAX_FRAMES_IN_FLIGHT 4
+
+// Measures real frame time and keeps the CPU from running too far ahead of the GPU
+typedef struct {
+    double last_time;
+    float frame_time;  // Last measured interval, unclamped, for reporting only
+    float nominal_dt;
+    int max_frames_in_flight;  // 0 disables latency limiting
+    GLsync fences[MAX_FRAMES_IN_FLIGHT];
+    int fence_index;
+} FramePacer;
+
+double monotonic_seconds(void);
+void create_frame_pacer(FramePacer* pacer, Display* display, GLXDrawable drawable,
+                        float nominal_dt, bool vsync, int max_frames_in_flight);
+void destroy_frame_pacer(FramePacer* pacer);
+void reset_frame_pacer(FramePacer* pacer);
+float begin_frame(FramePacer* pacer);
+void end_frame(FramePacer* pacer);
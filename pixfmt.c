@@ -0,0 +1,275 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pixfmt.h"
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define MAX_CONVERT_THREADS 4
+#define MIN_PIXELS_PER_THREAD (512 * 1024)
+
+static bool host_is_lsb_first(void) {
+    uint32_t probe = 1;
+    return *(const unsigned char*)&probe == 1;
+}
+
+static int mask_bits(unsigned long mask) {
+    return __builtin_popcountl(mask);
+}
+
+static int mask_shift(unsigned long mask) {
+    return mask ? __builtin_ctzl(mask) : 0;
+}
+
+PixelFormat describe_pixels(const XImage* image) {
+    PixelFormat format = {
+        .layout = PIXEL_GENERIC,
+        .bytes_per_pixel = image->bits_per_pixel / 8,
+        .host_order = (image->byte_order == LSBFirst) == host_is_lsb_first(),
+    };
+
+    unsigned long masks[3] = {image->red_mask, image->green_mask, image->blue_mask};
+    for (int c = 0; c < 3; c++) {
+        format.shift[c] = mask_shift(masks[c]);
+        format.bits[c] = mask_bits(masks[c]);
+    }
+
+    // 24 bpp rows are read byte by byte, there the image byte order is all that matters
+    if (image->bits_per_pixel == 24 && image->byte_order == LSBFirst &&
+        masks[0] == 0xff0000 && masks[1] == 0xff00 && masks[2] == 0xff) {
+        format.layout = PIXEL_RGB888;
+        return format;
+    }
+
+    if (!format.host_order) {
+        return format;
+    }
+
+    if (image->bits_per_pixel == 32) {
+        if (masks[0] == 0xff0000 && masks[1] == 0xff00 && masks[2] == 0xff) {
+            format.layout = PIXEL_XRGB8888;
+        } else if (masks[0] == 0xff && masks[1] == 0xff00 && masks[2] == 0xff0000) {
+            format.layout = PIXEL_XBGR8888;
+        } else if (masks[0] == 0x3ff00000 && masks[1] == 0xffc00 && masks[2] == 0x3ff) {
+            format.layout = PIXEL_XRGB2101010;
+        }
+    } else if (image->bits_per_pixel == 16 &&
+               masks[0] == 0xf800 && masks[1] == 0x7e0 && masks[2] == 0x1f) {
+        format.layout = PIXEL_RGB565;
+    }
+    return format;
+}
+
+static inline uint32_t xbgr_to_xrgb(uint32_t p) {
+    return ((p & 0xff) << 16) | (p & 0xff00) | ((p >> 16) & 0xff);
+}
+
+static inline uint32_t rgb2101010_to_xrgb(uint32_t p) {
+    return ((p >> 6) & 0xff0000) | ((p >> 4) & 0xff00) | ((p >> 2) & 0xff);
+}
+
+// Expands 5 and 6 bit channels by replicating their top bits
+static inline uint32_t rgb565_to_xrgb(uint32_t p) {
+    return ((p & 0xf800) << 8) | ((p & 0xe000) << 3) |
+           ((p & 0x07e0) << 5) | ((p & 0x0600) >> 1) |
+           ((p & 0x001f) << 3) | ((p & 0x001c) >> 2);
+}
+
+#ifdef __SSE2__
+static inline __m128i mask32(uint32_t mask) {
+    return _mm_set1_epi32((int)mask);
+}
+
+static int convert_xbgr_sse2(const uint32_t* src, int width, uint32_t* out) {
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i r = _mm_slli_epi32(_mm_and_si128(v, mask32(0xff)), 16);
+        __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), mask32(0xff));
+        __m128i g = _mm_and_si128(v, mask32(0xff00));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_or_si128(_mm_or_si128(r, g), b));
+    }
+    return i;
+}
+
+static int convert_2101010_sse2(const uint32_t* src, int width, uint32_t* out) {
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i r = _mm_and_si128(_mm_srli_epi32(v, 6), mask32(0xff0000));
+        __m128i g = _mm_and_si128(_mm_srli_epi32(v, 4), mask32(0xff00));
+        __m128i b = _mm_and_si128(_mm_srli_epi32(v, 2), mask32(0xff));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_or_si128(_mm_or_si128(r, g), b));
+    }
+    return i;
+}
+
+static inline __m128i rgb565_to_xrgb_sse2(__m128i p) {
+    __m128i r = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p, mask32(0xf800)), 8),
+                             _mm_slli_epi32(_mm_and_si128(p, mask32(0xe000)), 3));
+    __m128i g = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p, mask32(0x07e0)), 5),
+                             _mm_srli_epi32(_mm_and_si128(p, mask32(0x0600)), 1));
+    __m128i b = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(p, mask32(0x001f)), 3),
+                             _mm_srli_epi32(_mm_and_si128(p, mask32(0x001c)), 2));
+    return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+// Eight pixels per step, widened to 32 bits before expanding the channels
+static int convert_565_sse2(const uint16_t* src, int width, uint32_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(out + i), rgb565_to_xrgb_sse2(_mm_unpacklo_epi16(v, zero)));
+        _mm_storeu_si128((__m128i*)(out + i + 4), rgb565_to_xrgb_sse2(_mm_unpackhi_epi16(v, zero)));
+    }
+    return i;
+}
+#endif
+
+static inline unsigned long read_pixel(const unsigned char* p, int bytes, bool lsb_first) {
+    unsigned long pixel = 0;
+    for (int b = 0; b < bytes; b++) {
+        int index = lsb_first ? bytes - 1 - b : b;
+        pixel = (pixel << 8) | p[index];
+    }
+    return pixel;
+}
+
+static inline uint32_t expand_channel(unsigned long pixel, int shift, int bits) {
+    if (bits == 0) return 0;
+    unsigned long value = (pixel >> shift) & ((1ul << bits) - 1);
+    if (bits >= 8) return (uint32_t)(value >> (bits - 8));
+    // Same bit replication as the fixed layouts, so both paths agree
+    if (bits >= 4) return (uint32_t)((value << (8 - bits)) | (value >> (2 * bits - 8)));
+    return (uint32_t)(value * 255 / ((1ul << bits) - 1));
+}
+
+// Convert one row of `width` pixels starting at (x, y) to 0x??RRGGBB
+void convert_pixels(const PixelFormat* format, const XImage* image, int x, int y, int width, uint32_t* out) {
+    const unsigned char* row = (const unsigned char*)image->data + (size_t)y * image->bytes_per_line;
+    int i = 0;
+
+    switch (format->layout) {
+    case PIXEL_XRGB8888:
+        memcpy(out, row + (size_t)x * 4, (size_t)width * 4);
+        return;
+
+    case PIXEL_XBGR8888: {
+        const uint32_t* src = (const uint32_t*)row + x;
+#ifdef __SSE2__
+        i = convert_xbgr_sse2(src, width, out);
+#endif
+        for (; i < width; i++) out[i] = xbgr_to_xrgb(src[i]);
+        return;
+    }
+
+    case PIXEL_XRGB2101010: {
+        const uint32_t* src = (const uint32_t*)row + x;
+#ifdef __SSE2__
+        i = convert_2101010_sse2(src, width, out);
+#endif
+        for (; i < width; i++) out[i] = rgb2101010_to_xrgb(src[i]);
+        return;
+    }
+
+    case PIXEL_RGB565: {
+        const uint16_t* src = (const uint16_t*)row + x;
+#ifdef __SSE2__
+        i = convert_565_sse2(src, width, out);
+#endif
+        for (; i < width; i++) out[i] = rgb565_to_xrgb(src[i]);
+        return;
+    }
+
+    case PIXEL_RGB888: {
+        const unsigned char* src = row + (size_t)x * 3;
+        for (; i < width; i++) {
+            out[i] = ((uint32_t)src[3 * i + 2] << 16) | ((uint32_t)src[3 * i + 1] << 8) | src[3 * i];
+        }
+        return;
+    }
+
+    case PIXEL_GENERIC:
+        break;
+    }
+
+    // Sub byte depths are left to Xlib
+    if (format->bytes_per_pixel == 0) {
+        for (; i < width; i++) {
+            unsigned long pixel = XGetPixel((XImage*)image, x + i, y);
+            out[i] = (expand_channel(pixel, format->shift[0], format->bits[0]) << 16) |
+                     (expand_channel(pixel, format->shift[1], format->bits[1]) << 8) |
+                     expand_channel(pixel, format->shift[2], format->bits[2]);
+        }
+        return;
+    }
+
+    bool lsb_first = image->byte_order == LSBFirst;
+    const unsigned char* src = row + (size_t)x * format->bytes_per_pixel;
+    for (; i < width; i++) {
+        unsigned long pixel = read_pixel(src + (size_t)i * format->bytes_per_pixel,
+                                         format->bytes_per_pixel, lsb_first);
+        out[i] = (expand_channel(pixel, format->shift[0], format->bits[0]) << 16) |
+                 (expand_channel(pixel, format->shift[1], format->bits[1]) << 8) |
+                 expand_channel(pixel, format->shift[2], format->bits[2]);
+    }
+}
+
+typedef struct {
+    const PixelFormat* format;
+    const XImage* image;
+    XRectangle rect;
+    uint32_t* out;
+    pthread_t thread;
+    bool threaded;
+} ConvertJob;
+
+static void* convert_worker(void* arg) {
+    ConvertJob* job = arg;
+    for (int row = 0; row < job->rect.height; row++) {
+        convert_pixels(job->format, job->image, job->rect.x, job->rect.y + row, job->rect.width,
+                       job->out + (size_t)row * job->rect.width);
+    }
+    return NULL;
+}
+
+// Convert a rectangle into tightly packed rows at `out`. Large rectangles
+// are split into bands converted on separate threads.
+void convert_rect(const PixelFormat* format, const XImage* image, const XRectangle* rect, uint32_t* out) {
+    long pixels = (long)rect->width * rect->height;
+    int band_count = (int)(pixels / MIN_PIXELS_PER_THREAD);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (band_count > cpus) band_count = (int)cpus;
+    if (band_count > MAX_CONVERT_THREADS) band_count = MAX_CONVERT_THREADS;
+    if (band_count < 1) band_count = 1;
+
+    ConvertJob jobs[MAX_CONVERT_THREADS];
+    for (int i = 0; i < band_count; i++) {
+        int y0 = rect->height * i / band_count;
+        int y1 = rect->height * (i + 1) / band_count;
+        jobs[i] = (ConvertJob){
+            .format = format,
+            .image = image,
+            .rect = {rect->x, (short)(rect->y + y0), rect->width, (unsigned short)(y1 - y0)},
+            .out = out + (size_t)y0 * rect->width,
+        };
+    }
+
+    for (int i = 1; i < band_count; i++) {
+        jobs[i].threaded = pthread_create(&jobs[i].thread, NULL, convert_worker, &jobs[i]) == 0;
+        if (!jobs[i].threaded) {
+            convert_worker(&jobs[i]);
+        }
+    }
+    convert_worker(&jobs[0]);
+    for (int i = 1; i < band_count; i++) {
+        if (jobs[i].threaded) {
+            pthread_join(jobs[i].thread, NULL);
+        }
+    }
+}
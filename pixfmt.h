@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+typedef enum {
+    PIXEL_XRGB8888,     // 32 bpp 0x00RRGGBB, the common 24 and 32 bit visuals
+    PIXEL_XBGR8888,     // 32 bpp 0x00BBGGRR
+    PIXEL_XRGB2101010,  // 30 bit deep color
+    PIXEL_RGB565,       // 16 bit
+    PIXEL_RGB888,       // Packed 24 bpp, blue first in memory
+    PIXEL_GENERIC,      // Anything else, read through the channel masks
+} PixelLayout;
+
+// How the pixels of an XImage are laid out. The CPU side converts everything
+// to canonical 0x??RRGGBB, where the top byte is whatever the image padding
+// held. Fast kernels only run on images in host byte order.
+typedef struct {
+    PixelLayout layout;
+    int bytes_per_pixel;
+    bool host_order;
+    int shift[3];  // Red, green and blue, for PIXEL_GENERIC
+    int bits[3];
+} PixelFormat;
+
+PixelFormat describe_pixels(const XImage* image);
+void convert_pixels(const PixelFormat* format, const XImage* image, int x, int y, int width, uint32_t* out);
+void convert_rect(const PixelFormat* format, const XImage* image, const XRectangle* rect, uint32_t* out);
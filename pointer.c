@@ -0,0 +1,203 @@
+#include "pointer.h"
+#include <stdio.h>
+#include <string.h>
+#include <X11/extensions/XInput2.h>
+
+// Master pointer events on `window` plus device changes, which come for the
+// slaves. Selecting XI2 buttons also stops the core ones for this window.
+void create_pointer_devices(PointerDevices* devices, Display* display, Window window) {
+    memset(devices, 0, sizeof(*devices));
+
+    int event_base, error_base;
+    if (!XQueryExtension(display, "XInputExtension", &devices->opcode, &event_base, &error_base)) {
+        fprintf(stderr, "XInput2 is not available, using core pointer events\n");
+        return;
+    }
+    int major = 2, minor = 1;
+    if (XIQueryVersion(display, &major, &minor) != Success) {
+        fprintf(stderr, "XInput %d.%d is too old for smooth scrolling, using core pointer events\n", major, minor);
+        return;
+    }
+
+    unsigned char pointer_mask[XIMaskLen(XI_LASTEVENT)] = {0};
+    XISetMask(pointer_mask, XI_Motion);
+    XISetMask(pointer_mask, XI_ButtonPress);
+    XISetMask(pointer_mask, XI_ButtonRelease);
+    XISetMask(pointer_mask, XI_Enter);
+
+    unsigned char device_mask[XIMaskLen(XI_LASTEVENT)] = {0};
+    XISetMask(device_mask, XI_DeviceChanged);
+
+    XIEventMask masks[2] = {
+        {.deviceid = XIAllMasterDevices, .mask_len = sizeof(pointer_mask), .mask = pointer_mask},
+        {.deviceid = XIAllDevices, .mask_len = sizeof(device_mask), .mask = device_mask},
+    };
+    XISelectEvents(display, window, masks, 2);
+    devices->enabled = true;
+}
+
+// Forget the last scroll positions, the pointer may have scrolled elsewhere
+// since. Called whenever the pointer enters the window.
+void reset_pointer_devices(PointerDevices* devices) {
+    for (int i = 0; i < devices->axis_count; i++) {
+        devices->axes[i].has_last = false;
+    }
+}
+
+static ScrollAxis* scroll_axis(PointerDevices* devices, Display* display, int device) {
+    for (int i = 0; i < devices->axis_count; i++) {
+        if (devices->axes[i].device == device) {
+            return &devices->axes[i];
+        }
+    }
+
+    ScrollAxis* axis = devices->axis_count < MAX_SCROLL_DEVICES
+        ? &devices->axes[devices->axis_count++]
+        : &devices->axes[device % MAX_SCROLL_DEVICES];
+    *axis = (ScrollAxis){.device = device, .valuator = -1};
+
+    int count = 0;
+    XIDeviceInfo* info = XIQueryDevice(display, device, &count);
+    if (!info) {
+        return axis;
+    }
+    for (int i = 0; i < info->num_classes; i++) {
+        const XIScrollClassInfo* scroll = (const XIScrollClassInfo*)info->classes[i];
+        if (scroll->type == XIScrollClass && scroll->scroll_type == XIScrollTypeVertical && scroll->increment != 0.0) {
+            axis->valuator = scroll->number;
+            axis->increment = scroll->increment;
+        }
+    }
+    // Start from the current value so the first event is already a delta
+    for (int i = 0; i < info->num_classes; i++) {
+        const XIValuatorClassInfo* valuator = (const XIValuatorClassInfo*)info->classes[i];
+        if (valuator->type == XIValuatorClass && valuator->number == axis->valuator) {
+            axis->last = valuator->value;
+            axis->has_last = true;
+        }
+    }
+    XIFreeDeviceInfo(info);
+    return axis;
+}
+
+// Values are packed, one for each bit set in the mask
+static bool valuator_value(const XIValuatorState* state, int number, double* value) {
+    if (number < 0 || number >= state->mask_len * 8 || !XIMaskIsSet(state->mask, number)) {
+        return false;
+    }
+    int index = 0;
+    for (int i = 0; i < number; i++) {
+        if (XIMaskIsSet(state->mask, i)) index++;
+    }
+    *value = state->values[index];
+    return true;
+}
+
+static void handle_motion(PointerDevices* devices, Display* display, const XIDeviceEvent* motion,
+                          PointerInput* input) {
+    input->moved = true;
+    input->position = (Vec2f){(float)motion->event_x, (float)motion->event_y};
+
+    ScrollAxis* axis = scroll_axis(devices, display, motion->sourceid);
+    double value;
+    if (!valuator_value(&motion->valuators, axis->valuator, &value)) {
+        return;
+    }
+    // Emulated motion repeats deltas the device already reported, only follow it
+    if (axis->has_last && !(motion->flags & XIPointerEmulated)) {
+        float clicks = (float)((axis->last - value) / axis->increment);
+        if (motion->mods.effective & ControlMask) {
+            input->control_scroll += clicks;
+        } else {
+            input->scroll += clicks;
+        }
+    }
+    axis->last = value;
+    axis->has_last = true;
+}
+
+// Fold motion and smooth scrolling from `event` into `input` and return true.
+// XInput2 button events are rewritten in place as their core equivalents and
+// left to the caller like every other event, which gets false.
+bool translate_pointer_event(PointerDevices* devices, Display* display, XEvent* event, PointerInput* input) {
+    if (event->type == MotionNotify) {
+        input->moved = true;
+        input->position = (Vec2f){(float)event->xmotion.x, (float)event->xmotion.y};
+        return true;
+    }
+
+    XGenericEventCookie* cookie = &event->xcookie;
+    if (!devices->enabled || cookie->type != GenericEvent || cookie->extension != devices->opcode ||
+        !XGetEventData(display, cookie)) {
+        return false;
+    }
+
+    bool consumed = true;
+    switch (cookie->evtype) {
+    case XI_Motion:
+        handle_motion(devices, display, cookie->data, input);
+        break;
+
+    case XI_ButtonPress:
+    case XI_ButtonRelease: {
+        const XIDeviceEvent* button = cookie->data;
+        // Wheel clicks emulated from scroll valuators already came as motion
+        if (button->flags & XIPointerEmulated) {
+            break;
+        }
+        // Devices scrolling through a valuator zoom from motion alone, wheel
+        // buttons they send on top would zoom twice
+        if ((button->detail == 4 || button->detail == 5) &&
+            scroll_axis(devices, display, button->sourceid)->valuator >= 0) {
+            break;
+        }
+        XButtonEvent core = {
+            .type = cookie->evtype == XI_ButtonPress ? ButtonPress : ButtonRelease,
+            .serial = button->serial,
+            .display = display,
+            .window = button->event,
+            .root = button->root,
+            .subwindow = button->child,
+            .time = button->time,
+            .x = (int)button->event_x,
+            .y = (int)button->event_y,
+            .x_root = (int)button->root_x,
+            .y_root = (int)button->root_y,
+            .state = (unsigned int)button->mods.effective,
+            .button = (unsigned int)button->detail,
+            .same_screen = True,
+        };
+        input->moved = true;
+        input->position = (Vec2f){(float)button->event_x, (float)button->event_y};
+        XFreeEventData(display, cookie);
+        event->xbutton = core;
+        return false;
+    }
+
+    case XI_Enter:
+        reset_pointer_devices(devices);
+        break;
+
+    case XI_DeviceChanged: {
+        // Scroll classes may have changed, query them again on the next event
+        const XIDeviceChangedEvent* changed = cookie->data;
+        if (changed->reason == XISlaveSwitch) {
+            break;
+        }
+        for (int i = 0; i < devices->axis_count; i++) {
+            if (devices->axes[i].device == changed->sourceid) {
+                devices->axes[i] = devices->axes[--devices->axis_count];
+                break;
+            }
+        }
+        break;
+    }
+
+    default:
+        consumed = false;
+        break;
+    }
+
+    XFreeEventData(display, cookie);
+    return consumed;
+}
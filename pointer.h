@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <X11/Xlib.h>
+#include "la.h"
+
+#define MAX_SCROLL_DEVICES 16
+
+// Vertical scroll valuator of one slave device
+typedef struct {
+    int device;
+    int valuator;     // -1 when the device has no smooth scrolling
+    double increment; // Valuator units per wheel click, negative on natural scrolling
+    double last;
+    bool has_last;    // The first value after a reset only sets `last`
+} ScrollAxis;
+
+// XInput 2.1 pointer input. Motion arrives as sub-pixel positions and wheels
+// and touchpads report scrolling as valuator deltas instead of button clicks.
+// Without the extension the core events are used as before.
+typedef struct {
+    bool enabled;
+    int opcode;
+    ScrollAxis axes[MAX_SCROLL_DEVICES];
+    int axis_count;
+} PointerDevices;
+
+// Pointer input gathered from the queue between two frames. Motion is
+// coalesced to the last position, scrolling is summed in wheel clicks.
+typedef struct {
+    bool moved;
+    Vec2f position;
+    float scroll;          // Positive away from the user
+    float control_scroll;  // Scrolling with Control held
+} PointerInput;
+
+void create_pointer_devices(PointerDevices* devices, Display* display, Window window);
+void reset_pointer_devices(PointerDevices* devices);
+bool translate_pointer_event(PointerDevices* devices, Display* display, XEvent* event, PointerInput* input);
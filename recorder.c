@@ -0,0 +1,298 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "recorder.h"
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+bool parse_record_format(const char* name, RecordFormat* format) {
+    if (strcasecmp(name, "y4m") == 0) {
+        *format = RECORD_Y4M;
+    } else if (strcasecmp(name, "raw") == 0 || strcasecmp(name, "rgb") == 0) {
+        *format = RECORD_RAW;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Y4M unless the path ends in .raw or .rgb
+RecordFormat record_format_for_path(const char* path) {
+    const char* dot = strrchr(path, '.');
+    if (dot && (strcasecmp(dot, ".raw") == 0 || strcasecmp(dot, ".rgb") == 0)) {
+        return RECORD_RAW;
+    }
+    return RECORD_Y4M;
+}
+
+// BT.601 studio range, what players assume for Y4M without a range tag
+static inline unsigned char luma(int r, int g, int b) {
+    return (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline unsigned char chroma_u(int r, int g, int b) {
+    return (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline unsigned char chroma_v(int r, int g, int b) {
+    return (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// GL rows are BGRA, bottom row first. Chroma is the average of each 2x2
+// block, an odd last row or column is left out.
+static void convert_y4m(const Recorder* recorder, const unsigned char* pixels, unsigned char* out) {
+    int width = recorder->width & ~1;
+    int height = recorder->height & ~1;
+    size_t stride = (size_t)recorder->width * 4;
+    unsigned char* y_plane = out;
+    unsigned char* u_plane = out + (size_t)width * height;
+    unsigned char* v_plane = u_plane + (size_t)(width / 2) * (height / 2);
+
+    for (int y = 0; y < height; y += 2) {
+        const unsigned char* rows[2] = {
+            pixels + (size_t)(recorder->height - 1 - y) * stride,
+            pixels + (size_t)(recorder->height - 2 - y) * stride,
+        };
+        for (int x = 0; x < width; x += 2) {
+            int sum_r = 0, sum_g = 0, sum_b = 0;
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    const unsigned char* p = rows[dy] + (size_t)(x + dx) * 4;
+                    y_plane[(size_t)(y + dy) * width + x + dx] = luma(p[2], p[1], p[0]);
+                    sum_r += p[2];
+                    sum_g += p[1];
+                    sum_b += p[0];
+                }
+            }
+            size_t c = (size_t)(y / 2) * (width / 2) + x / 2;
+            u_plane[c] = chroma_u((sum_r + 2) / 4, (sum_g + 2) / 4, (sum_b + 2) / 4);
+            v_plane[c] = chroma_v((sum_r + 2) / 4, (sum_g + 2) / 4, (sum_b + 2) / 4);
+        }
+    }
+}
+
+static void convert_rgb(const Recorder* recorder, const unsigned char* pixels, unsigned char* out) {
+    size_t stride = (size_t)recorder->width * 4;
+    for (int y = 0; y < recorder->height; y++) {
+        const unsigned char* row = pixels + (size_t)(recorder->height - 1 - y) * stride;
+        for (int x = 0; x < recorder->width; x++) {
+            *out++ = row[x * 4 + 2];
+            *out++ = row[x * 4 + 1];
+            *out++ = row[x * 4];
+        }
+    }
+}
+
+static bool write_converted(Recorder* recorder) {
+    if (recorder->format == RECORD_Y4M && fputs("FRAME\n", recorder->out) == EOF) {
+        return false;
+    }
+    return fwrite(recorder->converted, 1, recorder->converted_size, recorder->out) == recorder->converted_size;
+}
+
+// Writer side of one slot: stretches the stream up to the slot's position
+// with the previous frame, then converts and writes the slot itself
+static bool write_slot(Recorder* recorder, const RecordSlot* slot) {
+    if (recorder->written_frame < 0) {
+        if (recorder->format == RECORD_Y4M) {
+            fprintf(recorder->out, "YUV4MPEG2 W%d H%d F%ld:1000 Ip A1:1 C420jpeg\n",
+                    recorder->width & ~1, recorder->height & ~1, lround(recorder->fps * 1000.0));
+        }
+        recorder->converted_size = recorder->format == RECORD_Y4M
+            ? (size_t)(recorder->width & ~1) * (recorder->height & ~1) * 3 / 2
+            : (size_t)recorder->width * recorder->height * 3;
+        recorder->converted = malloc(recorder->converted_size);
+        if (!recorder->converted) return false;
+    } else {
+        for (long long frame = recorder->written_frame + 1; frame < slot->frame; frame++) {
+            if (!write_converted(recorder)) return false;
+            recorder->repeated++;
+        }
+    }
+
+    if (recorder->format == RECORD_Y4M) {
+        convert_y4m(recorder, slot->pixels, recorder->converted);
+    } else {
+        convert_rgb(recorder, slot->pixels, recorder->converted);
+    }
+    recorder->written_frame = slot->frame;
+    return write_converted(recorder);
+}
+
+// Writes slots in ring order as the render thread maps them. Keeps draining
+// after a write error so the ring never fills up behind a dead pipe.
+static void* writer_main(void* arg) {
+    Recorder* recorder = arg;
+
+    pthread_mutex_lock(&recorder->lock);
+    for (;;) {
+        RecordSlot* slot = &recorder->slots[recorder->next_write];
+        while (slot->state != SLOT_MAPPED && !recorder->stopping) {
+            pthread_cond_wait(&recorder->ready, &recorder->lock);
+        }
+        if (slot->state != SLOT_MAPPED) break;
+        pthread_mutex_unlock(&recorder->lock);
+
+        // A failed mapping loses the frame, the next one repeats over the gap
+        if (!recorder->failed && slot->pixels && !write_slot(recorder, slot)) {
+            fprintf(stderr, "Recording stopped, could not write: %s\n", strerror(errno));
+            recorder->failed = true;
+        }
+
+        pthread_mutex_lock(&recorder->lock);
+        slot->state = SLOT_WRITTEN;
+        recorder->next_write = (recorder->next_write + 1) % RECORD_RING_SIZE;
+    }
+    pthread_mutex_unlock(&recorder->lock);
+
+    fflush(recorder->out);
+    return NULL;
+}
+
+// Start writing frames to `out` at `fps` frames per second. The recorder
+// closes `out` when it stops.
+bool start_recorder(Recorder* recorder, FILE* out, RecordFormat format, double fps) {
+    memset(recorder, 0, sizeof(*recorder));
+    recorder->out = out;
+    recorder->format = format;
+    recorder->fps = fps;
+    recorder->last_frame = -1;
+    recorder->written_frame = -1;
+
+    pthread_mutex_init(&recorder->lock, NULL);
+    pthread_cond_init(&recorder->ready, NULL);
+    if (pthread_create(&recorder->writer, NULL, writer_main, recorder) != 0) {
+        fprintf(stderr, "Could not start the recording thread\n");
+        pthread_mutex_destroy(&recorder->lock);
+        pthread_cond_destroy(&recorder->ready);
+        fclose(out);
+        return false;
+    }
+    return true;
+}
+
+static void map_slot(Recorder* recorder, RecordSlot* slot) {
+    glDeleteSync(slot->fence);
+    slot->fence = NULL;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    slot->pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)recorder->width * recorder->height * 4,
+                                    GL_MAP_READ_BIT);
+    slot->state = SLOT_MAPPED;
+    recorder->next_map = (recorder->next_map + 1) % RECORD_RING_SIZE;
+    pthread_cond_signal(&recorder->ready);
+}
+
+static void unmap_slot(RecordSlot* slot) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    slot->pixels = NULL;
+    slot->state = SLOT_FREE;
+}
+
+// Queue a readback of the frame about to be swapped, call right before
+// glXSwapBuffers. Never waits: finished readbacks go to the writer, frames
+// that find the ring full are dropped.
+void record_frame(Recorder* recorder, int width, int height, double time) {
+    if (recorder->width == 0) {
+        recorder->width = width;
+        recorder->height = height;
+        recorder->start_time = time;
+        if (recorder->format == RECORD_RAW) {
+            fprintf(stderr, "Recording %dx%d RGB24 at %.2f fps\n", width, height, recorder->fps);
+        }
+        for (int i = 0; i < RECORD_RING_SIZE; i++) {
+            glGenBuffers(1, &recorder->slots[i].pbo);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, recorder->slots[i].pbo);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)width * height * 4, NULL, GL_STREAM_READ);
+        }
+    }
+
+    pthread_mutex_lock(&recorder->lock);
+    for (int i = 0; i < RECORD_RING_SIZE; i++) {
+        if (recorder->slots[i].state == SLOT_WRITTEN) {
+            unmap_slot(&recorder->slots[i]);
+        }
+    }
+    while (recorder->slots[recorder->next_map].state == SLOT_READING) {
+        RecordSlot* slot = &recorder->slots[recorder->next_map];
+        GLenum status = glClientWaitSync(slot->fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+        map_slot(recorder, slot);
+    }
+    RecordSlot* slot = &recorder->slots[recorder->next_read];
+    bool slot_free = slot->state == SLOT_FREE;
+    pthread_mutex_unlock(&recorder->lock);
+
+    // Frames drawn faster than the stream rate are not read back at all
+    long long frame = llround((time - recorder->start_time) * recorder->fps);
+    if (frame <= recorder->last_frame) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return;
+    }
+
+    if (width != recorder->width || height != recorder->height) {
+        recorder->resized++;
+    } else if (!slot_free) {
+        recorder->dropped++;
+    } else {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+        glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+        slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot->frame = frame;
+        recorder->last_frame = frame;
+        recorder->captured++;
+
+        pthread_mutex_lock(&recorder->lock);
+        slot->state = SLOT_READING;
+        pthread_mutex_unlock(&recorder->lock);
+        recorder->next_read = (recorder->next_read + 1) % RECORD_RING_SIZE;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Flush the readbacks still in flight, wait for the writer and report. The
+// last frame is held until `time`, an idle tail would otherwise be cut off.
+void stop_recorder(Recorder* recorder, double time) {
+    pthread_mutex_lock(&recorder->lock);
+    while (recorder->slots[recorder->next_map].state == SLOT_READING) {
+        RecordSlot* slot = &recorder->slots[recorder->next_map];
+        glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        map_slot(recorder, slot);
+    }
+    recorder->stopping = true;
+    pthread_cond_broadcast(&recorder->ready);
+    pthread_mutex_unlock(&recorder->lock);
+    pthread_join(recorder->writer, NULL);
+
+    if (!recorder->failed && recorder->written_frame >= 0) {
+        long long end_frame = llround((time - recorder->start_time) * recorder->fps);
+        for (long long frame = recorder->written_frame + 1; frame < end_frame; frame++) {
+            if (!write_converted(recorder)) {
+                fprintf(stderr, "Recording stopped, could not write: %s\n", strerror(errno));
+                break;
+            }
+            recorder->repeated++;
+        }
+    }
+
+    for (int i = 0; i < RECORD_RING_SIZE; i++) {
+        RecordSlot* slot = &recorder->slots[i];
+        if (slot->state != SLOT_FREE) {
+            unmap_slot(slot);
+        }
+        if (slot->pbo) {
+            glDeleteBuffers(1, &slot->pbo);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    fclose(recorder->out);
+    free(recorder->converted);
+    pthread_mutex_destroy(&recorder->lock);
+    pthread_cond_destroy(&recorder->ready);
+
+    fprintf(stderr, "Recorded %lld frames, %lld of them repeats to keep time, %lld dropped, %lld skipped after a resize\n",
+            recorder->captured + recorder->repeated, recorder->repeated, recorder->dropped, recorder->resized);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <GL/glew.h>
+
+#define RECORD_RING_SIZE 4
+
+typedef enum {
+    RECORD_Y4M,  // YUV 4:2:0, what ffmpeg and most encoders read from a pipe
+    RECORD_RAW,  // Packed RGB24 rows, top first, the size is printed on start
+} RecordFormat;
+
+typedef enum {
+    SLOT_FREE,
+    SLOT_READING,  // glReadPixels queued, waiting on the fence
+    SLOT_MAPPED,   // Handed to the writer thread
+    SLOT_WRITTEN,  // Writer is done, unmapped on the next frame
+} RecordSlotState;
+
+typedef struct {
+    GLuint pbo;
+    GLsync fence;
+    RecordSlotState state;
+    const unsigned char* pixels;  // Mapping the writer reads from
+    long long frame;              // Position in the stream, from the frame's timestamp
+} RecordSlot;
+
+// Records the window as it is drawn. Every frame is read into a ring of pack
+// buffers right before the swap and handed to a writer thread once its fence
+// passed, so neither the readback nor the encoding stalls rendering. When
+// the ring is full the frame is dropped, the writer repeats the previous one
+// so the stream keeps real time.
+typedef struct {
+    FILE* out;
+    RecordFormat format;
+    int width, height;  // Fixed by the first frame
+    double fps;
+    double start_time;
+    long long last_frame;  // Last stream position a readback was queued for
+
+    RecordSlot slots[RECORD_RING_SIZE];
+    int next_read;   // Slot the next readback goes into
+    int next_map;    // Oldest readback still in flight
+    int next_write;  // Oldest slot the writer has not finished
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    bool stopping;
+    bool failed;
+
+    unsigned char* converted;  // Writer side, the previous frame stays for repeats
+    size_t converted_size;
+    long long written_frame;
+
+    // Counters, reported when recording stops
+    long long captured;
+    long long dropped;
+    long long resized;
+    long long repeated;
+} Recorder;
+
+bool parse_record_format(const char* name, RecordFormat* format);
+RecordFormat record_format_for_path(const char* path);
+bool start_recorder(Recorder* recorder, FILE* out, RecordFormat format, double fps);
+void record_frame(Recorder* recorder, int width, int height, double time);
+void stop_recorder(Recorder* recorder, double time);
@@ -0,0 +1,340 @@
+#include "render.h"
+#include "config.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Extra pixels around the lens for its antialiased edge and the 2x2 quads
+// the normal derivatives are taken over
+#define LENS_MARGIN 4.0f
+
+static const Blur* outside_blur(const Renderer* renderer) {
+    return renderer->has_outside_blur ? &renderer->outside_blur : NULL;
+}
+
+static const Blur* background_blur(const Renderer* renderer) {
+    if (!renderer->has_background_blur) return NULL;
+    return renderer->shared_blur ? &renderer->outside_blur : &renderer->background_blur;
+}
+
+// Recompute the cached blurs after the screenshot changed. The parts of the
+// tiles the refresh touched are downsampled again, rounded out to even pixels
+// so they land on whole blur texels. Tiles the camera has not seen are
+// streamed, not made resident.
+static void update_blurs(Renderer* renderer, const Screenshot* screenshot) {
+    Blur* blurs[2];
+    int blur_count = 0;
+    if (renderer->has_outside_blur) {
+        blurs[blur_count++] = &renderer->outside_blur;
+    }
+    if (renderer->has_background_blur && !renderer->shared_blur) {
+        blurs[blur_count++] = &renderer->background_blur;
+    }
+    if (blur_count == 0) {
+        return;
+    }
+
+    ScreenTexture* texture = &renderer->texture;
+    float width = (float)texture->width;
+    float height = (float)texture->height;
+
+    glActiveTexture(GL_TEXTURE0);
+    for (int d = 0; d < screenshot->dirty_count; d++) {
+        const XRectangle* dirty = &screenshot->dirty[d];
+        int dirty_x0 = dirty->x & ~1;
+        int dirty_y0 = dirty->y & ~1;
+        int dirty_x1 = (dirty->x + dirty->width + 1) & ~1;
+        int dirty_y1 = (dirty->y + dirty->height + 1) & ~1;
+
+        for (int i = 0; i < texture->columns * texture->rows; i++) {
+            const Tile* tile = &texture->tiles[i];
+            int x0 = dirty_x0 > tile->x ? dirty_x0 : tile->x;
+            int y0 = dirty_y0 > tile->y ? dirty_y0 : tile->y;
+            int x1 = dirty_x1 < tile->x + tile->width ? dirty_x1 : tile->x + tile->width;
+            int y1 = dirty_y1 < tile->y + tile->height ? dirty_y1 : tile->y + tile->height;
+            if (x1 <= x0 || y1 <= y0) continue;
+
+            XRectangle rect = {(short)x0, (short)y0, (unsigned short)(x1 - x0), (unsigned short)(y1 - y0)};
+            TileSource tile_source = stream_tile(texture, screenshot, i, &rect);
+            BlurSource source = {
+                tile_source.id,
+                x0 / width, y0 / height, x1 / width, y1 / height,
+                tile_source.u0, tile_source.v0, tile_source.u1, tile_source.v1,
+            };
+            for (int b = 0; b < blur_count; b++) {
+                add_blur_source(blurs[b], &source);
+            }
+        }
+    }
+
+    for (int b = 0; b < blur_count; b++) {
+        update_blur(blurs[b]);
+    }
+}
+
+// One quad per tile, in screenshot pixels with y pointing up like the old
+// single quad, so tile i is drawn with 6 indices starting at 6 * i
+static void build_tile_geometry(Renderer* renderer) {
+    const ScreenTexture* texture = &renderer->texture;
+    int count = texture->columns * texture->rows;
+    float h = (float)texture->height;
+
+    GLfloat* vertices = malloc((size_t)count * 4 * 5 * sizeof(GLfloat));
+    GLuint* indices = malloc((size_t)count * 6 * sizeof(GLuint));
+
+    for (int i = 0; i < count; i++) {
+        const Tile* tile = &texture->tiles[i];
+        float x0 = (float)tile->x;
+        float x1 = (float)(tile->x + tile->width);
+        float top = h - tile->y;
+        float bottom = h - (tile->y + tile->height);
+        float s0 = (float)TILE_GUTTER / tile->texture_width;
+        float s1 = (float)(TILE_GUTTER + tile->width) / tile->texture_width;
+        float t0 = (float)TILE_GUTTER / tile->texture_height;
+        float t1 = (float)(TILE_GUTTER + tile->height) / tile->texture_height;
+
+        GLfloat quad[] = {
+            x1, bottom, 0.0f, s1, t1,
+            x1, top,    0.0f, s1, t0,
+            x0, top,    0.0f, s0, t0,
+            x0, bottom, 0.0f, s0, t1
+        };
+        memcpy(&vertices[i * 20], quad, sizeof(quad));
+
+        GLuint base = i * 4;
+        GLuint quad_indices[] = {base + 0, base + 1, base + 3, base + 1, base + 2, base + 3};
+        memcpy(&indices[i * 6], quad_indices, sizeof(quad_indices));
+    }
+
+    glBindVertexArray(renderer->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->vbo);
+    glBufferData(GL_ARRAY_BUFFER, (size_t)count * 20 * sizeof(GLfloat), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t)count * 6 * sizeof(GLuint), indices, GL_STATIC_DRAW);
+
+    free(vertices);
+    free(indices);
+}
+
+void create_renderer(Renderer* renderer, ShaderLibrary* shaders, const Screenshot* screenshot) {
+    renderer->shaders = shaders;
+
+    glGenVertexArrays(1, &renderer->vao);
+    glGenBuffers(1, &renderer->vbo);
+    glGenBuffers(1, &renderer->ebo);
+
+    glActiveTexture(GL_TEXTURE0);
+    create_screen_texture(&renderer->texture, screenshot);
+    build_tile_geometry(renderer);
+    create_lens_profile(&renderer->lens);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)0);
+    glEnableVertexAttribArray(0);
+    
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(1);
+
+    // Both blurs are cached per capture, share one when the radii agree
+    renderer->has_outside_blur = config.blur_outside_flashlight;
+    renderer->has_background_blur = config.blur_background;
+    renderer->shared_blur = renderer->has_outside_blur && renderer->has_background_blur &&
+        config.background_blur_radius == config.outside_flashlight_blur_radius;
+
+    if (renderer->has_outside_blur) {
+        create_blur(&renderer->outside_blur, screenshot->image->width, screenshot->image->height,
+                    config.outside_flashlight_blur_radius);
+    }
+    if (renderer->has_background_blur && !renderer->shared_blur) {
+        create_blur(&renderer->background_blur, screenshot->image->width, screenshot->image->height,
+                    config.background_blur_radius);
+    }
+    update_blurs(renderer, screenshot);
+}
+
+void destroy_renderer(Renderer* renderer) {
+    destroy_screen_texture(&renderer->texture);
+    destroy_lens_profile(&renderer->lens);
+    if (renderer->has_background_blur && !renderer->shared_blur) {
+        destroy_blur(&renderer->background_blur);
+    }
+    if (renderer->has_outside_blur) {
+        destroy_blur(&renderer->outside_blur);
+    }
+    glDeleteVertexArrays(1, &renderer->vao);
+    glDeleteBuffers(1, &renderer->vbo);
+    glDeleteBuffers(1, &renderer->ebo);
+}
+
+// Push a refreshed screenshot to the GPU, only the dirty areas are uploaded
+void update_renderer(Renderer* renderer, const Screenshot* screenshot) {
+    int width = renderer->texture.width;
+    int height = renderer->texture.height;
+
+    glActiveTexture(GL_TEXTURE0);
+    upload_screen_texture(&renderer->texture, screenshot);
+    if (renderer->texture.width != width || renderer->texture.height != height) {
+        build_tile_geometry(renderer);
+    }
+    if (screenshot->dirty_count > 0) {
+        update_blurs(renderer, screenshot);
+    }
+}
+
+// Whether any part of the tile can land inside the window with this camera
+static bool tile_visible(const Tile* tile, Vec2f screenshot_size, const Camera* camera,
+                         Vec2f window_size) {
+    float half_width = window_size.x / (2.0f * camera->scale);
+    float half_height = window_size.y / (2.0f * camera->scale);
+    float center_x = camera->position.x + screenshot_size.x * 0.5f;
+    float center_y = screenshot_size.y * 0.5f - camera->position.y;
+
+    float x0 = (float)tile->x;
+    float x1 = (float)(tile->x + tile->width);
+    float y0 = screenshot_size.y - (tile->y + tile->height);
+    float y1 = screenshot_size.y - tile->y;
+
+    return x1 >= center_x - half_width && x0 <= center_x + half_width &&
+           y1 >= center_y - half_height && y0 <= center_y + half_height;
+}
+
+// Features the fragment shader needs for this frame, everything else is
+// compiled out of the variant
+static unsigned scene_features(const Flashlight* flashlight, const Blur* outside) {
+    if (flashlight->shadow < 0.01f) return 0;
+    if (!flashlight->is_enabled) return SHADER_SHADOW;
+    return SHADER_SHADOW | SHADER_LENS | (outside ? SHADER_BLUR_OUTSIDE : 0);
+}
+
+// Window rectangle (x, y, width, height, GL's bottom up y) the lens can
+// change. A square around the longest axis sdfEllipse allows, plus a
+// margin for the antialiased edge. False when it is entirely off screen.
+static bool lens_bounds(const Flashlight* flashlight, const Camera* camera, Vec2f window_size, int box[4]) {
+    float radius = flashlight->radius * camera->scale;
+    float extent = radius;
+    float stretch = vec2_length(flashlight->stretch);
+    if (stretch >= 0.01f) {
+        float along = fminf(fmaxf(radius * (1.0f + stretch), radius * 0.5f), radius * 2.0f);
+        float across = fminf(fmaxf(radius * (1.0f - flashlight->squeeze), radius * 0.3f), radius * 1.5f);
+        extent = fmaxf(along, across);
+    }
+    extent += LENS_MARGIN;
+
+    float center_x = flashlight->position.x;
+    float center_y = window_size.y - flashlight->position.y;
+    int x0 = (int)fmaxf(floorf(center_x - extent), 0.0f);
+    int y0 = (int)fmaxf(floorf(center_y - extent), 0.0f);
+    int x1 = (int)fminf(ceilf(center_x + extent), window_size.x);
+    int y1 = (int)fminf(ceilf(center_y + extent), window_size.y);
+    if (x1 <= x0 || y1 <= y0) return false;
+
+    box[0] = x0;
+    box[1] = y0;
+    box[2] = x1 - x0;
+    box[3] = y1 - y0;
+    return true;
+}
+
+// Draw every tile in view with `shader`
+static void draw_tiles(Renderer* renderer, GLuint shader, const Screenshot* screenshot, const Camera* camera,
+                       const Flashlight* flashlight, const Blur* outside, Vec2f window_size) {
+    glUseProgram(shader);
+    glUniform1i(glGetUniformLocation(shader, "tex"), 0);
+    glUniform1i(glGetUniformLocation(shader, "blurTex"), 1);
+    glUniform1i(glGetUniformLocation(shader, "lensProfile"), 2);
+
+    glUniform2f(glGetUniformLocation(shader, "cameraPos"), camera->position.x, camera->position.y);
+    glUniform1f(glGetUniformLocation(shader, "cameraScale"), camera->scale);
+    glUniform2f(glGetUniformLocation(shader, "screenshotSize"),
+                (float)screenshot->image->width, (float)screenshot->image->height);
+    glUniform2f(glGetUniformLocation(shader, "windowSize"), window_size.x, window_size.y);
+    
+    glUniform2f(glGetUniformLocation(shader, "cursorPos"), flashlight->position.x, flashlight->position.y);
+
+    glUniform2f(glGetUniformLocation(shader, "bubbleStretch"), flashlight->stretch.x, flashlight->stretch.y);
+    glUniform1f(glGetUniformLocation(shader, "bubbleSqueeze"), flashlight->squeeze);
+    
+    glUniform1f(glGetUniformLocation(shader, "flShadow"), flashlight->shadow);
+    glUniform1f(glGetUniformLocation(shader, "flRadius"), flashlight->radius);
+    // The built-in variants no longer read these, override shaders written before them still do
+    glUniform1f(glGetUniformLocation(shader, "flEnabled"), flashlight->is_enabled ? 1.0f : 0.0f);
+    glUniform1f(glGetUniformLocation(shader, "blur_outside_flashlight"), outside ? 1.0f : 0.0f);
+    
+    GLint tile_scale = glGetUniformLocation(shader, "tileScale");
+    GLint tile_bounds_location = glGetUniformLocation(shader, "tileBounds");
+    Vec2f screenshot_size = {(float)screenshot->image->width, (float)screenshot->image->height};
+
+    // Magnified pixels stay sharp squares, zoomed out they are averaged
+    // through the mip chain instead of aliasing
+    ScreenTexture* texture = &renderer->texture;
+    bool minified = camera->scale < 1.0f;
+    glBindSampler(0, minified ? texture->mip_sampler : 0);
+
+    // Only tiles in view are drawn, and only those ever get uploaded
+    glBindVertexArray(renderer->vao);
+    for (int i = 0; i < texture->columns * texture->rows; i++) {
+        const Tile* tile = &texture->tiles[i];
+        if (!tile_visible(tile, screenshot_size, camera, window_size)) continue;
+
+        float bounds[4];
+        tile_bounds(texture, i, bounds);
+        bind_tile(texture, screenshot, i, minified);
+        glUniform2f(tile_scale, screenshot_size.x / tile->texture_width,
+                    screenshot_size.y / tile->texture_height);
+        glUniform4f(tile_bounds_location, bounds[0], bounds[1], bounds[2], bounds[3]);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)(i * 6 * sizeof(GLuint)));
+    }
+    glBindSampler(0, 0);
+}
+
+void draw_scene(Renderer* renderer, const Screenshot* screenshot, const Camera* camera,
+                const Flashlight* flashlight, Vec2f window_size) {
+    const Blur* outside = outside_blur(renderer);
+    const Blur* background = background_blur(renderer);
+    unsigned features = scene_features(flashlight, outside);
+
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if (background) {
+        draw_blur(background);
+    }
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, outside ? outside->texture[BLUR_RESULT] : 0);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_1D, renderer->lens.texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    if (!(features & SHADER_SHADOW)) {
+        draw_tiles(renderer, shader_variant(renderer->shaders, features), screenshot, camera,
+                   flashlight, outside, window_size);
+        return;
+    }
+
+    // Outside the lens every pixel is one darkened fetch, only the pixels
+    // around the flashlight pay for the ellipse and the glass
+    unsigned background_features = SHADER_SHADOW | SHADER_BACKGROUND | (features & SHADER_BLUR_OUTSIDE);
+    draw_tiles(renderer, shader_variant(renderer->shaders, background_features), screenshot, camera,
+               flashlight, outside, window_size);
+
+    int box[4];
+    if (lens_bounds(flashlight, camera, window_size, box)) {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(box[0], box[1], box[2], box[3]);
+        draw_tiles(renderer, shader_variant(renderer->shaders, features), screenshot, camera,
+                   flashlight, outside, window_size);
+        glDisable(GL_SCISSOR_TEST);
+    }
+}
+
+// Bytes of GPU memory held by the screenshot texture, the lens profile and the blur caches
+size_t renderer_memory(const Renderer* renderer) {
+    size_t bytes = screen_texture_memory(&renderer->texture) + lens_profile_memory(&renderer->lens);
+    if (renderer->has_outside_blur) {
+        bytes += blur_memory(&renderer->outside_blur);
+    }
+    if (renderer->has_background_blur && !renderer->shared_blur) {
+        bytes += blur_memory(&renderer->background_blur);
+    }
+    return bytes;
+}
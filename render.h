@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <GL/glew.h>
+#include "screenshot.h"
+#include "camera.h"
+#include "flashlight.h"
+#include "texture.h"
+#include "blur.h"
+#include "lens.h"
+#include "shader.h"
+#include "la.h"
+
+// GPU side of a zoomer session: the screenshot quad, its texture and the
+// blur caches derived from it. Draws into whatever framebuffer is bound,
+// with the shader variant matching the flashlight and blur state.
+typedef struct {
+    ShaderLibrary* shaders;
+    GLuint vao, vbo, ebo;
+    ScreenTexture texture;
+    LensProfile lens;
+
+    Blur outside_blur;
+    Blur background_blur;
+    bool has_outside_blur;
+    bool has_background_blur;
+    bool shared_blur;  // Background reuses the outside blur when the radii agree
+} Renderer;
+
+void create_renderer(Renderer* renderer, ShaderLibrary* shaders, const Screenshot* screenshot);
+void destroy_renderer(Renderer* renderer);
+void update_renderer(Renderer* renderer, const Screenshot* screenshot);
+void draw_scene(Renderer* renderer, const Screenshot* screenshot, const Camera* camera,
+                const Flashlight* flashlight, Vec2f window_size);
+size_t renderer_memory(const Renderer* renderer);
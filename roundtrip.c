@@ -0,0 +1,29 @@
+#include "roundtrip.h"
+
+static int (*previous_after)(Display*);
+static unsigned long last_counted;
+static unsigned long count;
+
+// Xlib runs the after function at the end of every request call. A request
+// that waited for its reply leaves the last processed serial at its own, a
+// queued one cannot have been processed yet.
+static int count_round_trip(Display* display) {
+    unsigned long last_sent = NextRequest(display) - 1;
+    if (LastKnownRequestProcessed(display) == last_sent && last_sent != last_counted) {
+        last_counted = last_sent;
+        count++;
+    }
+    return previous_after ? previous_after(display) : 0;
+}
+
+// Count the Xlib calls on `display` that wait for the server. Requests GLX
+// makes through XCB are not seen. Install it once no other thread uses the
+// display anymore, the count is not synchronized.
+void watch_round_trips(Display* display) {
+    last_counted = NextRequest(display) - 1;
+    previous_after = XSetAfterFunction(display, count_round_trip);
+}
+
+unsigned long round_trip_count(void) {
+    return count;
+}
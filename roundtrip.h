@@ -0,0 +1,6 @@
+#pragma once
+
+#include <X11/Xlib.h>
+
+void watch_round_trips(Display* display);
+unsigned long round_trip_count(void);
@@ -1,64 +1,479 @@
 #include "screenshot.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-Screenshot create_screenshot(Display* display, Window window) {
-    Screenshot screenshot;
-    
+#ifdef MITSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <X11/Xlibint.h>
+
+// Attach errors are caught with an extension error hook matched against the
+// request serial. A global handler swapped in on the capture thread would
+// also swallow whatever errors the main thread gets meanwhile.
+static Display* shm_hooked_display = NULL;
+static int shm_major_opcode = 0;
+static unsigned long shm_attach_serial = 0;
+static bool shm_attach_failed = false;
+
+static int shm_attach_error(Display* display, xError* error, XExtCodes* codes, int* result) {
+    (void)display;
+    (void)codes;
+    if (error->majorCode != shm_major_opcode || error->sequenceNumber != (CARD16)shm_attach_serial) {
+        return False;
+    }
+    shm_attach_failed = true;
+    *result = 0;
+    return True;
+}
+
+static bool hook_shm_errors(Display* display) {
+    if (shm_hooked_display == display) {
+        return true;
+    }
+    XExtCodes* codes = XInitExtension(display, "MIT-SHM");
+    if (!codes) {
+        return false;
+    }
+    XESetError(display, codes->extension, shm_attach_error);
+    shm_major_opcode = codes->major_opcode;
+    shm_hooked_display = display;
+    return true;
+}
+
+// Create a shared segment of `size` bytes and attach it to the server.
+// Returns false, leaving nothing behind, when the server cannot attach it.
+static bool attach_segment(Display* display, XShmSegmentInfo* shminfo, size_t size) {
+    shminfo->shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (shminfo->shmid < 0) {
+        return false;
+    }
+
+    shminfo->shmaddr = shmat(shminfo->shmid, NULL, 0);
+    shminfo->readOnly = False;
+    if (shminfo->shmaddr == (char*)-1) {
+        shmctl(shminfo->shmid, IPC_RMID, NULL);
+        return false;
+    }
+
+    // XShmAttach fails asynchronously, sync so its error has arrived if any
+    shm_attach_failed = false;
+    if (hook_shm_errors(display)) {
+        XLockDisplay(display);
+        shm_attach_serial = NextRequest(display);
+        XShmAttach(display, shminfo);
+        XUnlockDisplay(display);
+        XSync(display, False);
+    } else {
+        shm_attach_failed = true;
+    }
+
+    // Mark the segment for removal now; it is freed once both sides detach
+    shmctl(shminfo->shmid, IPC_RMID, NULL);
+
+    if (shm_attach_failed) {
+        shmdt(shminfo->shmaddr);
+        return false;
+    }
+    return true;
+}
+
+static void detach_segment(Display* display, XShmSegmentInfo* shminfo) {
+    XShmDetach(display, shminfo);
+    shmdt(shminfo->shmaddr);
+}
+
+// Allocate a shared segment sized for the capture and attach it to the server.
+// Returns false (leaving no resources behind) when MIT-SHM cannot be used,
+// e.g. the extension is missing or the display is remote.
+static bool create_shm_image(Screenshot* screenshot, Display* display, int width, int height) {
+    if (!XShmQueryExtension(display)) {
+        return false;
+    }
+
+    XImage* image = XShmCreateImage(
+        display, screenshot->visual, screenshot->depth,
+        ZPixmap, NULL, &screenshot->shminfo,
+        width, height
+    );
+    if (!image) {
+        return false;
+    }
+
+    if (!attach_segment(display, &screenshot->shminfo, (size_t)image->bytes_per_line * image->height)) {
+        XDestroyImage(image);
+        return false;
+    }
+
+    image->data = screenshot->shminfo.shmaddr;
+    screenshot->image = image;
+    return true;
+}
+
+static void destroy_shm_image(Screenshot* screenshot, Display* display) {
+    XDestroyImage(screenshot->image);
+    detach_segment(display, &screenshot->shminfo);
+    screenshot->image = NULL;
+}
+
+#ifdef DAMAGE
+// Shared image for a `width` x `height` area, backed by a staging segment
+// that is attached once at the size of the whole capture
+static XImage* create_patch_image(Screenshot* screenshot, Display* display, int width, int height) {
+    if (!screenshot->patch_size) {
+        size_t size = (size_t)screenshot->image->bytes_per_line * screenshot->image->height;
+        if (!attach_segment(display, &screenshot->patch_shminfo, size)) {
+            return NULL;
+        }
+        screenshot->patch_size = size;
+    }
+
+    XImage* patch = XShmCreateImage(
+        display, screenshot->visual, screenshot->depth,
+        ZPixmap, NULL, &screenshot->patch_shminfo,
+        width, height
+    );
+    if (patch && (size_t)patch->bytes_per_line * patch->height > screenshot->patch_size) {
+        XDestroyImage(patch);
+        return NULL;
+    }
+    if (patch) {
+        patch->data = screenshot->patch_shminfo.shmaddr;
+    }
+    return patch;
+}
+#endif
+#endif
+
+static void mark_fully_dirty(Screenshot* screenshot) {
+    screenshot->dirty[0] = (XRectangle){
+        0, 0,
+        (unsigned short)screenshot->image->width,
+        (unsigned short)screenshot->image->height
+    };
+    screenshot->dirty_count = 1;
+}
+
+#ifdef DAMAGE
+static void create_damage(Screenshot* screenshot, Display* display, Window window) {
+    int error_base;
+    if (!XDamageQueryExtension(display, &screenshot->damage_event_base, &error_base)) {
+        fprintf(stderr, "XDamage is not available, refreshing the whole screen\n");
+        return;
+    }
+
+    // NonEmpty reports only once per batch, the rectangles are fetched on refresh
+    screenshot->damage = XDamageCreate(display, window, XDamageReportNonEmpty);
+    screenshot->damaged_region = XFixesCreateRegion(display, NULL, 0);
+}
+
+// Refetch only the rectangles damaged since the last refresh. Returns false
+// when the whole image should be recaptured instead.
+static bool refresh_damaged(Screenshot* screenshot, Display* display, Window window) {
+    screenshot->dirty_count = 0;
+    if (!screenshot->damaged) {
+        return true;
+    }
+    screenshot->damaged = false;
+
+    XDamageSubtract(display, screenshot->damage, None, screenshot->damaged_region);
+
+    int count = 0;
+    XRectangle* rects = XFixesFetchRegion(display, screenshot->damaged_region, &count);
+    if (!rects) {
+        return false;
+    }
+
+    int width = screenshot->image->width;
+    int height = screenshot->image->height;
+    long damaged_area = 0;
+    int min_x = width, min_y = height, max_x = 0, max_y = 0;
+
+    for (int i = 0; i < count; i++) {
+        // Damage is in window coordinates and can extend past the captured area
+        int x0 = rects[i].x - screenshot->x;
+        int y0 = rects[i].y - screenshot->y;
+        int x1 = x0 + rects[i].width;
+        int y1 = y0 + rects[i].height;
+        if (x0 < 0) x0 = 0;
+        if (y0 < 0) y0 = 0;
+        if (x1 > width) x1 = width;
+        if (y1 > height) y1 = height;
+        if (x1 <= x0 || y1 <= y0) continue;
+
+        if (screenshot->dirty_count < MAX_DIRTY_RECTS) {
+            screenshot->dirty[screenshot->dirty_count] = (XRectangle){
+                (short)x0, (short)y0, (unsigned short)(x1 - x0), (unsigned short)(y1 - y0)
+            };
+        }
+        screenshot->dirty_count++;
+        damaged_area += (long)(x1 - x0) * (y1 - y0);
+
+        if (x0 < min_x) min_x = x0;
+        if (y0 < min_y) min_y = y0;
+        if (x1 > max_x) max_x = x1;
+        if (y1 > max_y) max_y = y1;
+    }
+    XFree(rects);
+
+    // Past half the screen a single full capture is cheaper than many small ones
+    if (damaged_area * 2 > (long)width * height) {
+        return false;
+    }
+
+    // Too many rectangles to track individually, collapse them into their bounds
+    if (screenshot->dirty_count > MAX_DIRTY_RECTS) {
+        screenshot->dirty[0] = (XRectangle){
+            (short)min_x, (short)min_y, (unsigned short)(max_x - min_x), (unsigned short)(max_y - min_y)
+        };
+        screenshot->dirty_count = 1;
+    }
+    if (screenshot->dirty_count == 0) {
+        return true;
+    }
+
+    // Rows are copied with memcpy, sub byte depths go through a full capture
+    int bytes_per_pixel = screenshot->image->bits_per_pixel / 8;
+    if (screenshot->image->bits_per_pixel % 8 != 0) {
+        return false;
+    }
+
+    // A single fetch of the bounds of all rectangles, so the round trips do
+    // not grow with the damage count. Only the rectangles are copied over.
+    XImage* patch = NULL;
+#ifdef MITSHM
+    if (screenshot->use_shm) {
+        patch = create_patch_image(screenshot, display, max_x - min_x, max_y - min_y);
+        if (patch && !XShmGetImage(display, window, patch,
+                                   screenshot->x + min_x, screenshot->y + min_y, AllPlanes)) {
+            XDestroyImage(patch);
+            patch = NULL;
+        }
+    }
+#endif
+    if (!patch) {
+        patch = XGetImage(display, window, screenshot->x + min_x, screenshot->y + min_y,
+                          max_x - min_x, max_y - min_y, AllPlanes, ZPixmap);
+    }
+    if (!patch) {
+        return false;
+    }
+
+    for (int i = 0; i < screenshot->dirty_count; i++) {
+        const XRectangle* r = &screenshot->dirty[i];
+        size_t length = (size_t)r->width * bytes_per_pixel;
+        for (int row = 0; row < r->height; row++) {
+            memcpy(screenshot->image->data + (size_t)(r->y + row) * screenshot->image->bytes_per_line +
+                       (size_t)r->x * bytes_per_pixel,
+                   patch->data + (size_t)(r->y - min_y + row) * patch->bytes_per_line +
+                       (size_t)(r->x - min_x) * bytes_per_pixel,
+                   length);
+        }
+    }
+    // Shared images leave the staging segment alone when destroyed
+    XDestroyImage(patch);
+
+    return true;
+}
+#endif
+
+Screenshot create_screenshot_area(Display* display, Window window,
+                                  int x, int y, int width, int height) {
     XWindowAttributes attributes;
     XGetWindowAttributes(display, window, &attributes);
-    
+
+    Screenshot screenshot = {
+        .x = x,
+        .y = y,
+        .fixed_area = true,
+        .window = window,
+        .window_width = attributes.width,
+        .window_height = attributes.height,
+        .visual = attributes.visual,
+        .depth = attributes.depth,
+    };
+
+#ifdef MITSHM
+    screenshot.use_shm = create_shm_image(&screenshot, display, width, height);
+    if (screenshot.use_shm) {
+        if (XShmGetImage(display, window, screenshot.image, x, y, AllPlanes)) {
+#ifdef DAMAGE
+            create_damage(&screenshot, display, window);
+#endif
+            mark_fully_dirty(&screenshot);
+            return screenshot;
+        }
+        destroy_shm_image(&screenshot, display);
+        screenshot.use_shm = false;
+    }
+    fprintf(stderr, "MIT-SHM is not available, falling back to XGetImage\n");
+#endif
+
     screenshot.image = XGetImage(
         display, window,
-        0, 0,
-        attributes.width,
-        attributes.height,
+        x, y,
+        width,
+        height,
         AllPlanes,
         ZPixmap
     );
-    
-    return screenshot;
-}
 
-void destroy_screenshot(Screenshot* screenshot) {
-    if (screenshot->image) {
-        XDestroyImage(screenshot->image);
-        screenshot->image = NULL;
+    if (screenshot.image) {
+#ifdef DAMAGE
+        create_damage(&screenshot, display, window);
+#endif
+        mark_fully_dirty(&screenshot);
     }
+
+    return screenshot;
 }
 
-void refresh_screenshot(Screenshot* screenshot, Display* display, Window window) {
+Screenshot create_screenshot(Display* display, Window window) {
     XWindowAttributes attributes;
     XGetWindowAttributes(display, window, &attributes);
-    
-    XImage* refreshed = XGetSubImage(
-        display, window,
-        0, 0,
-        screenshot->image->width,
-        screenshot->image->height,
-        AllPlanes,
-        ZPixmap,
-        screenshot->image,
-        0, 0
-    );
-    
-    if (!refreshed || 
-        refreshed->width != attributes.width || 
-        refreshed->height != attributes.height) {
-        
-        XImage* new_image = XGetImage(
+
+    // Resizes arrive as ConfigureNotify through screenshot_handle_event()
+    XSelectInput(display, window, attributes.your_event_mask | StructureNotifyMask);
+
+    Screenshot screenshot = create_screenshot_area(display, window, 0, 0,
+                                                   attributes.width, attributes.height);
+    screenshot.fixed_area = false;
+    return screenshot;
+}
+
+void destroy_screenshot(Screenshot* screenshot, Display* display) {
+#ifdef DAMAGE
+    if (screenshot->damage) {
+        XDamageDestroy(display, screenshot->damage);
+        XFixesDestroyRegion(display, screenshot->damaged_region);
+        screenshot->damage = None;
+    }
+#ifdef MITSHM
+    if (screenshot->patch_size) {
+        detach_segment(display, &screenshot->patch_shminfo);
+        screenshot->patch_size = 0;
+    }
+#endif
+#endif
+
+    if (!screenshot->image) {
+        return;
+    }
+
+#ifdef MITSHM
+    if (screenshot->use_shm) {
+        destroy_shm_image(screenshot, display);
+        return;
+    }
+#else
+    (void)display;
+#endif
+
+    XDestroyImage(screenshot->image);
+    screenshot->image = NULL;
+}
+
+static void refresh_full(Screenshot* screenshot, Display* display, Window window, int width, int height) {
+#ifdef MITSHM
+    if (screenshot->use_shm) {
+        // The segment is sized for the old geometry, so reallocate it on
+        // resize. The old one stays until the new one is attached.
+        bool fits = screenshot->image->width == width && screenshot->image->height == height;
+        if (!fits) {
+            Screenshot old = *screenshot;
+            fits = create_shm_image(screenshot, display, width, height);
+            if (fits) {
+                destroy_shm_image(&old, display);
+#ifdef DAMAGE
+                // The staging segment is attached again at the new size when needed
+                if (screenshot->patch_size) {
+                    detach_segment(display, &screenshot->patch_shminfo);
+                    screenshot->patch_size = 0;
+                }
+#endif
+            } else {
+                screenshot->image = old.image;
+                screenshot->shminfo = old.shminfo;
+            }
+        }
+
+        if (fits &&
+            XShmGetImage(display, window, screenshot->image,
+                         screenshot->x, screenshot->y, AllPlanes)) {
+            mark_fully_dirty(screenshot);
+            return;
+        }
+
+        // Give up the segment for a plain image, but only once there is one
+        XImage* fallback = XGetImage(
             display, window,
-            0, 0,
-            attributes.width,
-            attributes.height,
+            screenshot->x, screenshot->y,
+            width,
+            height,
             AllPlanes,
             ZPixmap
         );
-        
-        if (new_image) {
-            XDestroyImage(screenshot->image);
-            screenshot->image = new_image;
+        if (!fallback) {
+            screenshot->dirty_count = 0;
+            return;
         }
-    } else {
-        screenshot->image = refreshed;
+        destroy_shm_image(screenshot, display);
+        screenshot->use_shm = false;
+        screenshot->image = fallback;
+        mark_fully_dirty(screenshot);
+        return;
+    }
+#endif
+
+    // A fresh image is swapped in. XGetSubImage into the old one would copy
+    // the reply over pixel by pixel with XPutPixel, slower than the fetch.
+    XImage* refreshed = XGetImage(
+        display, window,
+        screenshot->x, screenshot->y,
+        width,
+        height,
+        AllPlanes,
+        ZPixmap
+    );
+    if (!refreshed) {
+        screenshot->dirty_count = 0;
+        return;
+    }
+
+    XDestroyImage(screenshot->image);
+    screenshot->image = refreshed;
+    mark_fully_dirty(screenshot);
+}
+
+void refresh_screenshot(Screenshot* screenshot, Display* display, Window window) {
+    int width = screenshot->fixed_area ? screenshot->image->width : screenshot->window_width;
+    int height = screenshot->fixed_area ? screenshot->image->height : screenshot->window_height;
+
+#ifdef DAMAGE
+    if (screenshot->damage &&
+        screenshot->image->width == width &&
+        screenshot->image->height == height &&
+        refresh_damaged(screenshot, display, window)) {
+        return;
+    }
+#endif
+
+    refresh_full(screenshot, display, window, width, height);
+}
+
+// Feed X events to the capture layer, returns true when the event was consumed
+bool screenshot_handle_event(Screenshot* screenshot, const XEvent* event) {
+    if (event->type == ConfigureNotify && event->xconfigure.window == screenshot->window) {
+        screenshot->window_width = event->xconfigure.width;
+        screenshot->window_height = event->xconfigure.height;
+        return true;
+    }
+#ifdef DAMAGE
+    if (screenshot->damage && event->type == screenshot->damage_event_base + XDamageNotify) {
+        screenshot->damaged = true;
+        return true;
     }
+#endif
+    return false;
 }
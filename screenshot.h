@@ -1,12 +1,60 @@
 #pragma once
 
+#include <stdbool.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 
+#ifdef MITSHM
+#include <X11/extensions/XShm.h>
+#endif
+
+#ifdef DAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
+
+#define MAX_DIRTY_RECTS 32
+
 typedef struct {
     XImage* image;
+
+    // Top left corner of the captured area in window coordinates. Area
+    // captures keep their size, full window captures follow resizes.
+    int x;
+    int y;
+    bool fixed_area;
+
+    // Captured window as of the last ConfigureNotify, so refreshing does
+    // not have to ask the server first
+    Window window;
+    int window_width;
+    int window_height;
+    Visual* visual;
+    int depth;
+
+    // Area refreshed by the last capture, in image coordinates
+    XRectangle dirty[MAX_DIRTY_RECTS];
+    int dirty_count;
+#ifdef MITSHM
+    // Shared segment the image lives in, reused across refreshes
+    XShmSegmentInfo shminfo;
+    bool use_shm;
+#endif
+#ifdef DAMAGE
+#ifdef MITSHM
+    // Staging segment damaged areas are fetched through, 0 size until used
+    XShmSegmentInfo patch_shminfo;
+    size_t patch_size;
+#endif
+    Damage damage;
+    XserverRegion damaged_region;
+    int damage_event_base;
+    bool damaged;
+#endif
 } Screenshot;
 
 Screenshot create_screenshot(Display* display, Window window);
-void destroy_screenshot(Screenshot* screenshot);
+Screenshot create_screenshot_area(Display* display, Window window,
+                                  int x, int y, int width, int height);
+void destroy_screenshot(Screenshot* screenshot, Display* display);
 void refresh_screenshot(Screenshot* screenshot, Display* display, Window window);
+bool screenshot_handle_event(Screenshot* screenshot, const XEvent* event);
@@ -0,0 +1,413 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "shader.h"
+#include "shaders.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_PATH_SIZE 600
+
+static char* read_file(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return NULL;
+    
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    
+    char* content = malloc(size + 1);
+    fread(content, 1, size, f);
+    content[size] = '\0';
+    fclose(f);
+    
+    return content;
+}
+
+// Use the shader at `override_path` when there is one, the built-in source otherwise
+void load_shader(Shader* shader, const char* override_path, GLenum type) {
+    if (override_path && override_path[0] != '\0') {
+        char* content = read_file(override_path);
+        if (content) {
+            snprintf(shader->path, sizeof(shader->path), "%s", override_path);
+            shader->content = content;
+            return;
+        }
+        fprintf(stderr, "Warning: Could not load shader from config path: %s, using the built-in one\n",
+                override_path);
+    }
+
+    snprintf(shader->path, sizeof(shader->path), "built-in");
+    shader->content = strdup(type == GL_VERTEX_SHADER ? vert_glsl : frag_glsl);
+}
+
+void free_shader(Shader* shader) {
+    free(shader->content);
+    shader->content = NULL;
+}
+
+// The defines have to follow the #version line, #line keeps the line numbers
+// in compile errors pointing at the file
+static char* insert_defines(const char* source, const char* defines) {
+    const char* body = source;
+    int next_line = 1;
+    if (strncmp(source, "#version", 8) == 0) {
+        const char* newline = strchr(source, '\n');
+        body = newline ? newline + 1 : source + strlen(source);
+        next_line = 2;
+    }
+
+    size_t head = (size_t)(body - source);
+    size_t size = strlen(source) + strlen(defines) + 32;
+    char* result = malloc(size);
+    snprintf(result, size, "%.*s%s%s#line %d\n%s", (int)head, source,
+             head > 0 && source[head - 1] != '\n' ? "\n" : "", defines, next_line, body);
+    return result;
+}
+
+static GLuint compile_shader(const Shader* shader, GLenum type, const char* defines) {
+    GLuint id = glCreateShader(type);
+    char* src = insert_defines(shader->content, defines);
+    glShaderSource(id, 1, (const char**)&src, NULL);
+    glCompileShader(id);
+    free(src);
+    
+    GLint success;
+    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char log[512];
+        glGetShaderInfoLog(id, sizeof(log), NULL, log);
+        fprintf(stderr, "Shader compilation error (%s):\n%s\n", shader->path, log);
+    }
+    
+    return id;
+}
+
+static uint64_t fnv1a(uint64_t hash, const char* data) {
+    for (const unsigned char* p = (const unsigned char*)data; p && *p; p++) {
+        hash ^= *p;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// $XDG_CACHE_HOME/zoomer/program-<variant>.bin, named after the shader paths
+// and the variant's defines so a relinked variant overwrites its old entry.
+// `key` covers both sources and the driver, since binaries are only valid for
+// the driver that produced them, and is stored in the entry to detect stale ones.
+// Returns false when there is no cache directory to use.
+static bool program_cache_path(char* path, size_t size, const Shader* vertex, const Shader* fragment,
+                               const char* defines, uint64_t* key) {
+    char directory[512];
+    const char* cache_home = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (cache_home && cache_home[0]) {
+        snprintf(directory, sizeof(directory), "%s", cache_home);
+    } else if (home) {
+        snprintf(directory, sizeof(directory), "%s/.cache", home);
+    } else {
+        return false;
+    }
+    mkdir(directory, 0700);
+    strncat(directory, "/zoomer", sizeof(directory) - strlen(directory) - 1);
+    mkdir(directory, 0700);
+
+    uint64_t variant = 0xcbf29ce484222325ull;
+    variant = fnv1a(variant, vertex->path);
+    variant = fnv1a(variant, "\x1f");
+    variant = fnv1a(variant, fragment->path);
+    variant = fnv1a(variant, "\x1f");
+    variant = fnv1a(variant, defines);
+
+    uint64_t hash = fnv1a(variant, "\x1f");
+    hash = fnv1a(hash, vertex->content);
+    hash = fnv1a(hash, "\x1f");
+    hash = fnv1a(hash, fragment->content);
+    hash = fnv1a(hash, (const char*)glGetString(GL_VENDOR));
+    hash = fnv1a(hash, (const char*)glGetString(GL_RENDERER));
+    hash = fnv1a(hash, (const char*)glGetString(GL_VERSION));
+    *key = hash;
+
+    int written = snprintf(path, size, "%s/program-%016llx.bin", directory, (unsigned long long)variant);
+    return written > 0 && (size_t)written < size;
+}
+
+// Link a program straight from a cached binary, 0 on a miss or a stale entry
+static GLuint load_program_binary(const char* path, uint64_t key) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint64_t stored_key = 0;
+    GLenum format = 0;
+    long length = size - (long)sizeof(stored_key) - (long)sizeof(format);
+    void* binary = length > 0 ? malloc(length) : NULL;
+    bool ok = binary &&
+        fread(&stored_key, sizeof(stored_key), 1, f) == 1 && stored_key == key &&
+        fread(&format, sizeof(format), 1, f) == 1 &&
+        fread(binary, 1, length, f) == (size_t)length;
+    fclose(f);
+
+    GLuint program = 0;
+    if (ok) {
+        program = glCreateProgram();
+        glProgramBinary(program, format, binary, (GLsizei)length);
+
+        // Drivers reject binaries after an update, just compile again
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    free(binary);
+    return program;
+}
+
+static void save_program_binary(GLuint program, const char* path, uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    void* binary = malloc(length);
+    GLenum format;
+    glGetProgramBinary(program, length, NULL, &format, binary);
+
+    // Write to a temporary file first so a crash never leaves half an entry behind
+    char temporary[CACHE_PATH_SIZE + sizeof(".tmp")];
+    int written = snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE* f = written > 0 && (size_t)written < sizeof(temporary) ? fopen(temporary, "wb") : NULL;
+    if (f) {
+        bool ok = fwrite(&key, sizeof(key), 1, f) == 1 &&
+                  fwrite(&format, sizeof(format), 1, f) == 1 &&
+                  fwrite(binary, 1, length, f) == (size_t)length;
+        ok = fclose(f) == 0 && ok;
+        if (ok) {
+            rename(temporary, path);
+        } else {
+            remove(temporary);
+        }
+    }
+
+    free(binary);
+}
+
+// Link the sources with `defines` in front of the fragment shader body.
+// Returns 0 when the program does not link.
+GLuint create_shader_program(const Shader* vertex, const Shader* fragment, const char* defines) {
+    bool cacheable = GLEW_ARB_get_program_binary;
+    char cache_path[CACHE_PATH_SIZE];
+    uint64_t cache_key = 0;
+    if (cacheable) {
+        cacheable = program_cache_path(cache_path, sizeof(cache_path), vertex, fragment, defines, &cache_key);
+    }
+
+    if (cacheable) {
+        GLuint program = load_program_binary(cache_path, cache_key);
+        if (program) {
+            glUseProgram(program);
+            return program;
+        }
+    }
+
+    GLuint vs = compile_shader(vertex, GL_VERTEX_SHADER, "");
+    GLuint fs = compile_shader(fragment, GL_FRAGMENT_SHADER, defines);
+    
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    if (cacheable) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(program);
+    
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char log[512];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        fprintf(stderr, "Shader linking error:\n%s\n", log);
+        glDeleteProgram(program);
+        program = 0;
+    } else if (cacheable) {
+        save_program_binary(program, cache_path, cache_key);
+    }
+    
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    glUseProgram(program);
+    
+    return program;
+}
+
+static bool is_override(const Shader* shader) {
+    return strcmp(shader->path, "built-in") != 0;
+}
+
+static const char* file_name(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// Editors often save by renaming a new file over the old one, which ends a
+// watch on the file itself, so the directory holding it is watched instead
+static int watch_override(ShaderLibrary* library, const Shader* shader) {
+    if (!is_override(shader)) return -1;
+
+    if (library->watch_fd < 0) {
+        library->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (library->watch_fd < 0) {
+            perror("inotify_init1");
+            return -1;
+        }
+    }
+
+    char directory[256];
+    snprintf(directory, sizeof(directory), "%s", shader->path);
+    char* slash = strrchr(directory, '/');
+    if (!slash) {
+        snprintf(directory, sizeof(directory), ".");
+    } else if (slash == directory) {
+        slash[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+
+    int watch = inotify_add_watch(library->watch_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch < 0) {
+        fprintf(stderr, "Warning: Could not watch %s for shader changes: %s\n", directory, strerror(errno));
+    }
+    return watch;
+}
+
+void create_shader_library(ShaderLibrary* library, const char* vertex_path, const char* fragment_path) {
+    memset(library, 0, sizeof(*library));
+    load_shader(&library->vertex, vertex_path, GL_VERTEX_SHADER);
+    load_shader(&library->fragment, fragment_path, GL_FRAGMENT_SHADER);
+
+    library->watch_fd = -1;
+    library->watches[0] = watch_override(library, &library->vertex);
+    library->watches[1] = watch_override(library, &library->fragment);
+}
+
+void destroy_shader_library(ShaderLibrary* library) {
+    for (int i = 0; i < SHADER_VARIANT_COUNT; i++) {
+        if (library->programs[i]) {
+            glDeleteProgram(library->programs[i]);
+        }
+    }
+    free_shader(&library->vertex);
+    free_shader(&library->fragment);
+    if (library->watch_fd >= 0) {
+        close(library->watch_fd);
+    }
+}
+
+static void variant_defines(unsigned features, char* defines, size_t size) {
+    static const char* names[] = {"SHADOW", "LENS", "BLUR_OUTSIDE", "BACKGROUND"};
+    size_t length = 0;
+    defines[0] = '\0';
+    for (int i = 0; i < 4; i++) {
+        if (features & (1u << i)) {
+            length += snprintf(defines + length, size - length, "#define %s\n", names[i]);
+        }
+    }
+}
+
+// Program for a combination of ShaderFeature bits, linked on first use.
+// Returns 0 when that variant does not build.
+GLuint shader_variant(ShaderLibrary* library, unsigned features) {
+    features &= SHADER_VARIANT_COUNT - 1;
+    if (!library->programs[features] && !(library->failed & (1u << features))) {
+        char defines[128];
+        variant_defines(features, defines, sizeof(defines));
+        library->programs[features] = create_shader_program(&library->vertex, &library->fragment, defines);
+        if (!library->programs[features]) {
+            library->failed |= 1u << features;
+        }
+    }
+    return library->programs[features];
+}
+
+static bool override_changed(const struct inotify_event* event, int watch, const Shader* shader) {
+    return watch >= 0 && event->wd == watch && event->len > 0 &&
+           strcmp(event->name, file_name(shader->path)) == 0;
+}
+
+static bool reread_shader(const Shader* current, Shader* next) {
+    snprintf(next->path, sizeof(next->path), "%s", current->path);
+    next->content = is_override(current) ? read_file(current->path) : strdup(current->content);
+    return next->content != NULL;
+}
+
+// Relink every variant built so far when an override was saved. Never
+// blocks. The previous programs stay in use when the new sources do not
+// build, so a typo mid edit does not take the picture away.
+bool reload_shader_library(ShaderLibrary* library) {
+    if (library->watch_fd < 0) return false;
+
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t length;
+    while ((length = read(library->watch_fd, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + length;) {
+            const struct inotify_event* event = (const struct inotify_event*)p;
+            changed = changed ||
+                override_changed(event, library->watches[0], &library->vertex) ||
+                override_changed(event, library->watches[1], &library->fragment);
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    if (!changed) return false;
+
+    Shader vertex = {0}, fragment = {0};
+    if (!reread_shader(&library->vertex, &vertex) || !reread_shader(&library->fragment, &fragment)) {
+        fprintf(stderr, "Warning: Could not read the changed shaders, keeping the previous ones\n");
+        free_shader(&vertex);
+        free_shader(&fragment);
+        return false;
+    }
+
+    GLuint programs[SHADER_VARIANT_COUNT] = {0};
+    bool ok = true;
+    for (unsigned i = 0; i < SHADER_VARIANT_COUNT && ok; i++) {
+        if (!library->programs[i]) continue;
+        char defines[128];
+        variant_defines(i, defines, sizeof(defines));
+        programs[i] = create_shader_program(&vertex, &fragment, defines);
+        ok = programs[i] != 0;
+    }
+
+    GLuint* discard = ok ? library->programs : programs;
+    for (int i = 0; i < SHADER_VARIANT_COUNT; i++) {
+        if (discard[i]) {
+            glDeleteProgram(discard[i]);
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Warning: Changed shaders did not build, keeping the previous ones\n");
+        free_shader(&vertex);
+        free_shader(&fragment);
+        return false;
+    }
+
+    memcpy(library->programs, programs, sizeof(programs));
+    library->failed = 0;
+    free_shader(&library->vertex);
+    free_shader(&library->fragment);
+    library->vertex = vertex;
+    library->fragment = fragment;
+    printf("Reloaded shaders\n");
+    fflush(stdout);
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <GL/glew.h>
+
+typedef struct {
+    char path[256];  // "built-in" unless a file overrides the compiled in source
+    char* content;
+} Shader;
+
+// Features compiled into a fragment shader variant as #defines rather than
+// branched on per fragment
+typedef enum {
+    SHADER_SHADOW = 1 << 0,        // Darkens everything outside the flashlight
+    SHADER_LENS = 1 << 1,          // Refracting glass inside the flashlight
+    SHADER_BLUR_OUTSIDE = 1 << 2,  // Blurred screenshot around the flashlight
+    SHADER_BACKGROUND = 1 << 3,    // Only the darkened part outside the lens
+} ShaderFeature;
+
+#define SHADER_VARIANT_COUNT 16
+
+// Both sources and every variant linked from them so far. Variants are built
+// the first time they are asked for. Override files are watched with inotify
+// and the built variants relinked whenever one is saved.
+typedef struct {
+    Shader vertex;
+    Shader fragment;
+    GLuint programs[SHADER_VARIANT_COUNT];
+    unsigned failed;  // Variants that did not link, not retried until a reload
+
+    int watch_fd;     // -1 when no override is watched
+    int watches[2];   // Directory watches for the vertex and fragment overrides
+} ShaderLibrary;
+
+void load_shader(Shader* shader, const char* override_path, GLenum type);
+void free_shader(Shader* shader);
+GLuint create_shader_program(const Shader* vertex, const Shader* fragment, const char* defines);
+
+void create_shader_library(ShaderLibrary* library, const char* vertex_path, const char* fragment_path);
+void destroy_shader_library(ShaderLibrary* library);
+GLuint shader_variant(ShaderLibrary* library, unsigned features);
+bool reload_shader_library(ShaderLibrary* library);
@@ -0,0 +1,492 @@
+#include "texture.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int mip_levels(int width, int height) {
+    int levels = 1;
+    int size = width > height ? width : height;
+    while (size > 1 && levels < TILE_MIP_LEVELS) {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
+static void create_upload_ring(ScreenTexture* texture, size_t size) {
+    texture->pbo_size = size;
+    texture->next = 0;
+    texture->persistent = GLEW_ARB_buffer_storage;
+
+    glGenBuffers(UPLOAD_RING_SIZE, texture->pbo);
+    for (int i = 0; i < UPLOAD_RING_SIZE; i++) {
+        texture->fence[i] = NULL;
+        texture->mapped[i] = NULL;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->pbo[i]);
+
+        if (texture->persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+            texture->mapped[i] = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+        } else {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+static void destroy_upload_ring(ScreenTexture* texture) {
+    for (int i = 0; i < UPLOAD_RING_SIZE; i++) {
+        if (texture->fence[i]) {
+            glDeleteSync(texture->fence[i]);
+            texture->fence[i] = NULL;
+        }
+        if (texture->mapped[i]) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->pbo[i]);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            texture->mapped[i] = NULL;
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(UPLOAD_RING_SIZE, texture->pbo);
+}
+
+static void create_tiles(ScreenTexture* texture, int width, int height) {
+    texture->width = width;
+    texture->height = height;
+    texture->columns = (width + TILE_SIZE - 1) / TILE_SIZE;
+    texture->rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+    texture->tiles = calloc((size_t)texture->columns * texture->rows, sizeof(Tile));
+    texture->resident = 0;
+
+    for (int row = 0; row < texture->rows; row++) {
+        for (int column = 0; column < texture->columns; column++) {
+            Tile* tile = &texture->tiles[row * texture->columns + column];
+            tile->x = column * TILE_SIZE;
+            tile->y = row * TILE_SIZE;
+            tile->width = width - tile->x < TILE_SIZE ? width - tile->x : TILE_SIZE;
+            tile->height = height - tile->y < TILE_SIZE ? height - tile->y : TILE_SIZE;
+            tile->texture_width = tile->width + 2 * TILE_GUTTER;
+            tile->texture_height = tile->height + 2 * TILE_GUTTER;
+        }
+    }
+}
+
+static void destroy_tiles(ScreenTexture* texture) {
+    int count = texture->columns * texture->rows;
+    for (int i = 0; i < count; i++) {
+        if (texture->tiles[i].id) {
+            glDeleteTextures(1, &texture->tiles[i].id);
+        }
+    }
+    free(texture->tiles);
+    texture->tiles = NULL;
+    texture->resident = 0;
+
+    if (texture->scratch) {
+        glDeleteTextures(1, &texture->scratch);
+        texture->scratch = 0;
+    }
+}
+
+static GLuint allocate_storage(int width, int height, int levels, GLenum internal_format) {
+    GLuint id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+
+    if (GLEW_ARB_texture_storage) {
+        glTexStorage2D(GL_TEXTURE_2D, levels, internal_format, width, height);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    // X leaves the padding byte undefined, never let it leak into the alpha channel
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ONE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    return id;
+}
+
+// Area of the image a tile texture holds: its own pixels plus the gutter
+// that falls inside the image
+static XRectangle tile_extent(const ScreenTexture* texture, const Tile* tile) {
+    int x0 = tile->x - TILE_GUTTER > 0 ? tile->x - TILE_GUTTER : 0;
+    int y0 = tile->y - TILE_GUTTER > 0 ? tile->y - TILE_GUTTER : 0;
+    int x1 = tile->x + tile->width + TILE_GUTTER;
+    int y1 = tile->y + tile->height + TILE_GUTTER;
+    if (x1 > texture->width) x1 = texture->width;
+    if (y1 > texture->height) y1 = texture->height;
+    return (XRectangle){(short)x0, (short)y0, (unsigned short)(x1 - x0), (unsigned short)(y1 - y0)};
+}
+
+// Pick the GL format and type that read the image rows as they are. Any
+// byte order works for 16 and 32 bit pixels since GL can swap them itself.
+static void choose_upload_format(ScreenTexture* texture, const XImage* image) {
+    unsigned long r = image->red_mask, g = image->green_mask, b = image->blue_mask;
+    int bits = image->bits_per_pixel;
+    int bytes = bits / 8;
+
+    texture->pixels = describe_pixels(image);
+    texture->swap_bytes = !texture->pixels.host_order && bits != 24;
+    texture->internal_format = GL_RGBA8;
+    texture->direct = true;
+
+    if (bits == 32 && r == 0xff0000 && g == 0xff00 && b == 0xff) {
+        texture->upload_format = GL_BGRA;
+        texture->upload_type = GL_UNSIGNED_INT_8_8_8_8_REV;
+    } else if (bits == 32 && r == 0xff && g == 0xff00 && b == 0xff0000) {
+        texture->upload_format = GL_RGBA;
+        texture->upload_type = GL_UNSIGNED_INT_8_8_8_8_REV;
+    } else if (bits == 32 && r == 0x3ff00000 && g == 0xffc00 && b == 0x3ff) {
+        // Keep all 10 bits of deep color visuals
+        texture->upload_format = GL_BGRA;
+        texture->upload_type = GL_UNSIGNED_INT_2_10_10_10_REV;
+        texture->internal_format = GL_RGB10_A2;
+    } else if (bits == 16 && r == 0xf800 && g == 0x7e0 && b == 0x1f) {
+        texture->upload_format = GL_RGB;
+        texture->upload_type = GL_UNSIGNED_SHORT_5_6_5;
+    } else if (texture->pixels.layout == PIXEL_RGB888) {
+        texture->upload_format = GL_BGR;
+        texture->upload_type = GL_UNSIGNED_BYTE;
+    } else {
+        texture->direct = false;
+    }
+
+    // GL_UNPACK_ROW_LENGTH counts pixels, odd strides have to be converted
+    if (texture->direct && image->bytes_per_line % bytes != 0) {
+        texture->direct = false;
+    }
+
+    if (!texture->direct) {
+        texture->swap_bytes = false;
+        texture->upload_format = GL_BGRA;
+        texture->upload_type = GL_UNSIGNED_INT_8_8_8_8_REV;
+        texture->internal_format = GL_RGBA8;
+    }
+    texture->upload_bytes_per_pixel = texture->direct ? bytes : 4;
+}
+
+void create_screen_texture(ScreenTexture* texture, const Screenshot* screenshot) {
+    const XImage* image = screenshot->image;
+
+    texture->scratch = 0;
+    texture->staging = NULL;
+    choose_upload_format(texture, image);
+
+    glGenSamplers(1, &texture->mip_sampler);
+    glSamplerParameteri(texture->mip_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glSamplerParameteri(texture->mip_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(texture->mip_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(texture->mip_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    create_tiles(texture, image->width, image->height);
+    // The first tile is always the largest one, plus room to align every rectangle
+    create_upload_ring(texture, (size_t)texture->tiles[0].texture_width *
+                                texture->tiles[0].texture_height * 4 + MAX_DIRTY_RECTS * 4);
+}
+
+void destroy_screen_texture(ScreenTexture* texture) {
+    destroy_upload_ring(texture);
+    destroy_tiles(texture);
+    glDeleteSamplers(1, &texture->mip_sampler);
+    texture->mip_sampler = 0;
+    free(texture->staging);
+    texture->staging = NULL;
+}
+
+// Acquire the next ring slot for writing. Returns NULL when the slot is still
+// in flight, in which case the caller uploads straight from client memory
+// rather than waiting on the GPU.
+static unsigned char* map_slot(ScreenTexture* texture, int slot) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->pbo[slot]);
+
+    if (texture->persistent) {
+        if (texture->fence[slot]) {
+            GLenum status = glClientWaitSync(texture->fence[slot], 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED) {
+                return NULL;
+            }
+            glDeleteSync(texture->fence[slot]);
+            texture->fence[slot] = NULL;
+        }
+        return texture->mapped[slot];
+    }
+
+    // Orphan the old storage so the driver can hand back fresh memory immediately
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, texture->pbo_size, NULL, GL_STREAM_DRAW);
+    return glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, texture->pbo_size,
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+                            GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+static void begin_unpack(const ScreenTexture* texture) {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_SWAP_BYTES, texture->swap_bytes ? GL_TRUE : GL_FALSE);
+}
+
+static void end_unpack(void) {
+    glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_FALSE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+static void upload_from_client_memory(ScreenTexture* texture, const XImage* image, int origin_x, int origin_y,
+                                      const XRectangle* rects, int count) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    begin_unpack(texture);
+
+    if (texture->direct) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, image->bytes_per_line / texture->upload_bytes_per_pixel);
+        for (int i = 0; i < count; i++) {
+            const XRectangle* r = &rects[i];
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, r->x);
+            glPixelStorei(GL_UNPACK_SKIP_ROWS, r->y);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, r->x - origin_x, r->y - origin_y, r->width, r->height,
+                            texture->upload_format, texture->upload_type, image->data);
+        }
+    } else {
+        if (!texture->staging) {
+            texture->staging = malloc(texture->pbo_size);
+        }
+        for (int i = 0; i < count && texture->staging; i++) {
+            const XRectangle* r = &rects[i];
+            convert_rect(&texture->pixels, image, r, texture->staging);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, r->x - origin_x, r->y - origin_y, r->width, r->height,
+                            texture->upload_format, texture->upload_type, texture->staging);
+        }
+    }
+
+    end_unpack();
+}
+
+// Stream rectangles of the image into the bound texture, whose texel (0, 0)
+// sits at (origin_x, origin_y) in the image
+static void upload_rects(ScreenTexture* texture, const XImage* image, int origin_x, int origin_y,
+                         const XRectangle* rects, int count) {
+    int slot = texture->next;
+    unsigned char* dst = map_slot(texture, slot);
+    if (!dst) {
+        upload_from_client_memory(texture, image, origin_x, origin_y, rects, count);
+        return;
+    }
+    texture->next = (slot + 1) % UPLOAD_RING_SIZE;
+
+    // Pack every rectangle tightly into the slot, one after another,
+    // converting on the way when GL cannot read the image format
+    size_t bytes_per_pixel = texture->upload_bytes_per_pixel;
+    size_t offsets[MAX_DIRTY_RECTS];
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        const XRectangle* r = &rects[i];
+        size_t row_size = (size_t)r->width * bytes_per_pixel;
+        offsets[i] = offset;
+
+        if (!texture->direct) {
+            convert_rect(&texture->pixels, image, r, (uint32_t*)(dst + offset));
+        } else {
+            const char* src = image->data + (size_t)r->y * image->bytes_per_line + (size_t)r->x * bytes_per_pixel;
+            if (row_size == (size_t)image->bytes_per_line) {
+                memcpy(dst + offset, src, row_size * r->height);
+            } else {
+                for (int y = 0; y < r->height; y++) {
+                    memcpy(dst + offset + y * row_size, src + (size_t)y * image->bytes_per_line, row_size);
+                }
+            }
+        }
+
+        // Packed types want offsets aligned to their size
+        offset += (row_size * r->height + 3) & ~(size_t)3;
+    }
+
+    if (!texture->persistent) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    begin_unpack(texture);
+    for (int i = 0; i < count; i++) {
+        const XRectangle* r = &rects[i];
+        glTexSubImage2D(GL_TEXTURE_2D, 0, r->x - origin_x, r->y - origin_y, r->width, r->height,
+                        texture->upload_format, texture->upload_type, (const void*)offsets[i]);
+    }
+    end_unpack();
+
+    if (texture->persistent) {
+        texture->fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// Bring the rectangles the last refresh touched into every resident tile.
+// Tiles that are not resident yet read the whole image once they are needed.
+void upload_screen_texture(ScreenTexture* texture, const Screenshot* screenshot) {
+    const XImage* image = screenshot->image;
+    if (screenshot->dirty_count == 0) {
+        return;
+    }
+
+    // Tile layout depends on the image size, start over on resize
+    if (image->width != texture->width || image->height != texture->height) {
+        destroy_screen_texture(texture);
+        create_screen_texture(texture, screenshot);
+        return;
+    }
+
+    int count = texture->columns * texture->rows;
+    for (int i = 0; i < count; i++) {
+        Tile* tile = &texture->tiles[i];
+        if (!tile->id) continue;
+
+        XRectangle extent = tile_extent(texture, tile);
+        XRectangle clipped[MAX_DIRTY_RECTS];
+        int clipped_count = 0;
+
+        for (int j = 0; j < screenshot->dirty_count; j++) {
+            const XRectangle* r = &screenshot->dirty[j];
+            int x0 = r->x > extent.x ? r->x : extent.x;
+            int y0 = r->y > extent.y ? r->y : extent.y;
+            int x1 = r->x + r->width < extent.x + extent.width ? r->x + r->width : extent.x + extent.width;
+            int y1 = r->y + r->height < extent.y + extent.height ? r->y + r->height : extent.y + extent.height;
+            if (x1 <= x0 || y1 <= y0) continue;
+
+            clipped[clipped_count++] = (XRectangle){
+                (short)x0, (short)y0, (unsigned short)(x1 - x0), (unsigned short)(y1 - y0)
+            };
+        }
+
+        if (clipped_count > 0) {
+            glBindTexture(GL_TEXTURE_2D, tile->id);
+            upload_rects(texture, image, tile->x - TILE_GUTTER, tile->y - TILE_GUTTER,
+                         clipped, clipped_count);
+            // Rebuilt the next time the tile is drawn zoomed out, not on every refresh
+            tile->mips_stale = tile->levels > 1;
+        }
+    }
+}
+
+// Give a tile room for its mip chain. Level 0 is copied over on the GPU
+// when the driver can, otherwise read from the image again.
+static void add_mip_levels(ScreenTexture* texture, const Screenshot* screenshot, Tile* tile) {
+    GLuint old = tile->id;
+    tile->levels = mip_levels(tile->texture_width, tile->texture_height);
+    tile->id = allocate_storage(tile->texture_width, tile->texture_height, tile->levels,
+                                texture->internal_format);
+
+    XRectangle extent = tile_extent(texture, tile);
+    int x = extent.x - (tile->x - TILE_GUTTER);
+    int y = extent.y - (tile->y - TILE_GUTTER);
+    if (GLEW_ARB_copy_image) {
+        glCopyImageSubData(old, GL_TEXTURE_2D, 0, x, y, 0, tile->id, GL_TEXTURE_2D, 0, x, y, 0,
+                           extent.width, extent.height, 1);
+    } else {
+        upload_rects(texture, screenshot->image, tile->x - TILE_GUTTER, tile->y - TILE_GUTTER,
+                     &extent, 1);
+    }
+    glDeleteTextures(1, &old);
+    tile->mips_stale = true;
+}
+
+// Bind a tile's texture, uploading it first if the tile was never seen before.
+// Tiles start with level 0 only, the mip chain is built the first time the
+// tile is drawn minified and refreshed lazily after that.
+GLuint bind_tile(ScreenTexture* texture, const Screenshot* screenshot, int index, bool minified) {
+    Tile* tile = &texture->tiles[index];
+    if (!tile->id) {
+        tile->levels = 1;
+        tile->mips_stale = false;
+        tile->id = allocate_storage(tile->texture_width, tile->texture_height, 1,
+                                    texture->internal_format);
+        XRectangle extent = tile_extent(texture, tile);
+        upload_rects(texture, screenshot->image, tile->x - TILE_GUTTER, tile->y - TILE_GUTTER,
+                     &extent, 1);
+        texture->resident++;
+    } else {
+        glBindTexture(GL_TEXTURE_2D, tile->id);
+    }
+
+    if (minified) {
+        if (tile->levels == 1) {
+            add_mip_levels(texture, screenshot, tile);
+        }
+        if (tile->mips_stale) {
+            glGenerateMipmap(GL_TEXTURE_2D);
+            tile->mips_stale = false;
+        }
+    }
+    return tile->id;
+}
+
+// Texture with the pixels of `rect`, a part of the tile's own pixels in image
+// coordinates, for a single read. Tiles that are not resident go through a
+// shared scratch texture instead of becoming resident, only `rect` is uploaded.
+TileSource stream_tile(ScreenTexture* texture, const Screenshot* screenshot, int index, const XRectangle* rect) {
+    const Tile* tile = &texture->tiles[index];
+    int x0 = rect->x - tile->x;
+    int y0 = rect->y - tile->y;
+    int x1 = x0 + rect->width;
+    int y1 = y0 + rect->height;
+    if (tile->id) {
+        return (TileSource){
+            tile->id,
+            (float)(TILE_GUTTER + x0) / tile->texture_width,
+            (float)(TILE_GUTTER + y0) / tile->texture_height,
+            (float)(TILE_GUTTER + x1) / tile->texture_width,
+            (float)(TILE_GUTTER + y1) / tile->texture_height,
+        };
+    }
+
+    if (!texture->scratch) {
+        texture->scratch_width = texture->tiles[0].width;
+        texture->scratch_height = texture->tiles[0].height;
+        texture->scratch = allocate_storage(texture->scratch_width, texture->scratch_height, 1,
+                                            texture->internal_format);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture->scratch);
+    upload_rects(texture, screenshot->image, tile->x, tile->y, rect, 1);
+
+    return (TileSource){
+        texture->scratch,
+        (float)x0 / texture->scratch_width,
+        (float)y0 / texture->scratch_height,
+        (float)x1 / texture->scratch_width,
+        (float)y1 / texture->scratch_height,
+    };
+}
+
+// Texture coordinates a tile can be sampled at without leaving the pixels it
+// holds, half a texel in from its own pixels plus whatever gutter is in the image
+void tile_bounds(const ScreenTexture* texture, int index, float bounds[4]) {
+    const Tile* tile = &texture->tiles[index];
+    XRectangle extent = tile_extent(texture, tile);
+    float x0 = extent.x - (tile->x - TILE_GUTTER) + 0.5f;
+    float y0 = extent.y - (tile->y - TILE_GUTTER) + 0.5f;
+    bounds[0] = x0 / tile->texture_width;
+    bounds[1] = y0 / tile->texture_height;
+    bounds[2] = (x0 + extent.width - 1.0f) / tile->texture_width;
+    bounds[3] = (y0 + extent.height - 1.0f) / tile->texture_height;
+}
+
+// Bytes of GPU memory held by the resident tiles and the upload ring
+size_t screen_texture_memory(const ScreenTexture* texture) {
+    size_t bytes = 0;
+    int count = texture->columns * texture->rows;
+    for (int i = 0; i < count; i++) {
+        const Tile* tile = &texture->tiles[i];
+        if (!tile->id) continue;
+
+        int width = tile->texture_width;
+        int height = tile->texture_height;
+        for (int level = 0; level < tile->levels; level++) {
+            bytes += (size_t)width * height * 4;
+            if (width > 1) width /= 2;
+            if (height > 1) height /= 2;
+        }
+    }
+    if (texture->scratch) {
+        bytes += (size_t)texture->scratch_width * texture->scratch_height * 4;
+    }
+    return bytes + texture->pbo_size * UPLOAD_RING_SIZE;
+}
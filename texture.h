@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <GL/glew.h>
+#include "screenshot.h"
+#include "pixfmt.h"
+
+#define UPLOAD_RING_SIZE 3
+
+// The screenshot is split into tiles of at most TILE_SIZE pixels. Each tile
+// texture also holds TILE_GUTTER pixels of its neighbours on every side, so
+// the lens can refract across a seam without switching textures.
+#define TILE_TEXTURE_SIZE 2048
+#define TILE_GUTTER 64
+#define TILE_SIZE (TILE_TEXTURE_SIZE - 2 * TILE_GUTTER)
+
+// Mip chains stop where the gutter is one texel wide, below that a tile's
+// texels would start mixing with pixels that are not in the gutter
+#define TILE_MIP_LEVELS 7
+
+typedef struct {
+    GLuint id;           // 0 until the camera first sees the tile
+    int x, y;            // Top left of the tile's own pixels in the image
+    int width, height;
+    int texture_width;   // Own pixels plus the gutter on both sides
+    int texture_height;
+    int levels;          // 1 until the tile is first drawn zoomed out
+    bool mips_stale;     // Level 0 changed since the chain was built
+} Tile;
+
+// Part of a texture holding a tile's own pixels, for one-off reads
+typedef struct {
+    GLuint id;
+    float u0, v0, u1, v1;
+} TileSource;
+
+// Tiled screenshot texture fed through a ring of pixel unpack buffers, so the
+// CPU fills slot N+1 while the GPU is still copying out of slot N. Tiles are
+// uploaded on first use, memory grows with the area looked at rather than
+// with the size of the desktop.
+typedef struct {
+    int width;
+    int height;
+    int columns;
+    int rows;
+    Tile* tiles;
+    int resident;
+
+    GLuint mip_sampler;  // Trilinear sampling for tiles drawn zoomed out
+
+    GLuint scratch;  // Streams tiles that are read once but not resident
+    int scratch_width;
+    int scratch_height;
+
+    // Images GL can read as they are go up untouched, with the byte order
+    // fixed by GL_UNPACK_SWAP_BYTES. The rest is converted to 0x00RRGGBB.
+    PixelFormat pixels;
+    bool direct;
+    bool swap_bytes;
+    int upload_bytes_per_pixel;
+    GLenum upload_format;
+    GLenum upload_type;
+    GLenum internal_format;
+    uint32_t* staging;  // Converted pixels when no ring slot is free
+
+    GLuint pbo[UPLOAD_RING_SIZE];
+    GLsync fence[UPLOAD_RING_SIZE];
+    void* mapped[UPLOAD_RING_SIZE];  // Persistent mappings, NULL when orphaning
+    size_t pbo_size;
+    int next;
+    bool persistent;
+} ScreenTexture;
+
+void create_screen_texture(ScreenTexture* texture, const Screenshot* screenshot);
+void destroy_screen_texture(ScreenTexture* texture);
+void upload_screen_texture(ScreenTexture* texture, const Screenshot* screenshot);
+GLuint bind_tile(ScreenTexture* texture, const Screenshot* screenshot, int index, bool minified);
+TileSource stream_tile(ScreenTexture* texture, const Screenshot* screenshot, int index, const XRectangle* rect);
+void tile_bounds(const ScreenTexture* texture, int index, float bounds[4]);
+size_t screen_texture_memory(const ScreenTexture* texture);
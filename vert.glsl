@@ -3,6 +3,7 @@
 in vec3 aPos;
 in vec2 aTexCoord;
 out vec2 texcoord;
+out vec2 screenUV;
 
 uniform vec2 cameraPos;
 uniform float cameraScale;
@@ -24,4 +25,6 @@ void main()
 {
     gl_Position = vec4(to_world((aPos - vec3(cameraPos * vec2(1.0, -1.0), 0.0))), 1.0);
     texcoord = aTexCoord;
+    // Texture coordinates across the whole screenshot, texcoord only spans one tile
+    screenUV = vec2(aPos.x / screenshotSize.x, 1.0 - aPos.y / screenshotSize.y);
 }